@@ -1,6 +1,8 @@
 // Copyright NEXON Games Co., MIT License
 #include "AnimNode_AnimPhys.h"
 #include "AnimPhysInterface.h"
+#include "AnimPhysSubsystem.h"
+#include "AnimPhysLaneBatch.h"
 #include "Animation/AnimInstanceProxy.h"
 #include "PhysicsEngine/PhysicsSettings.h"
 #include "PhysicsEngine/PhysicsAsset.h"
@@ -9,6 +11,8 @@
 #include "GameFramework/CharacterMovementComponent.h"
 
 static TAutoConsoleVariable<int32> CVarEnableAnimPhys(TEXT("EnableAnimPhys"), 1, TEXT("Enable Anim Phys"));
+static TAutoConsoleVariable<int32> CVarAnimPhysPhysBodyRecheckFrames(TEXT("AnimPhys.PhysBodyRecheckFrames"), 30, TEXT("Frames between full checks of the PhysBody simulation state on mesh components that do not report a generation. 0 checks every frame"));
+static TAutoConsoleVariable<int32> CVarAnimPhysParallelGather(TEXT("AnimPhys.ParallelGather"), 0, TEXT("Copy the bone transforms of all AnimPhys nodes in one parallel pass at the end of the frame instead of in PreUpdate. The other inputs read the world or game code and are still gathered by each node in PreUpdate"));
 
 #if !UE_BUILD_SHIPPING
 static TAutoConsoleVariable<int32> CVarDrawDebugAnimPhys(TEXT("DrawDebugAnimPhys"), 0, TEXT("Draw Debug Anim Phys"));
@@ -29,6 +33,16 @@ FAnimNode_AnimPhys::FAnimNode_AnimPhys()
 
 FAnimNode_AnimPhys::~FAnimNode_AnimPhys()
 {
+	CancelBatchedSolve();
+	CancelFrameNode();
+	WaitPipelinedSolve();
+
+	UAnimPhysSubsystem* Subsystem = NodeData.Subsystem.Get();
+	if (Subsystem && NodeData.RegisteredNode == this)
+	{
+		Subsystem->UnregisterNode(this);
+	}
+
 #if WITH_EDITORONLY_DATA
 	FCoreUObjectDelegates::OnObjectPropertyChanged.Remove(EditData.ObjectPropertyChangedHandle);
 	EditData.ObjectPropertyChangedHandle.Reset();
@@ -42,23 +56,29 @@ void FAnimNode_AnimPhys::Initialize_AnyThread(const FAnimationInitializeContext&
 
 	Base.Initialize(Context);
 
-	WorkData.Simulated.SimulatedBones.Empty();
+	CancelBatchedSolve();
+	WaitPipelinedSolve();
+	NodeData.bPendingPipelinedSolve = false;
+	NodeData.bBoneTransformsCopied = false;
+	NodeData.PhysBodyGeneration = INDEX_NONE;
 
-	WorkData.Cached.ComponentSpaceTMs.Empty();
-	WorkData.Cached.AttachedComponentSpaceTMs.Empty();
-	WorkData.Cached.NumComponentSpaceTransforms = 0;
-	WorkData.Cached.NumAttachedComponentSpaceTransforms = 0;
-	WorkData.Cached.AttachedMesh = NAME_None;
-	WorkData.Cached.bHasCachedTransforms = false;
+	WorkData.Simulated.Empty();
+
+	WorkData.Cached.Empty();
 
 	WorkData.Collided.Spheres.Empty();
 	WorkData.Collided.Capsules.Empty();
 	WorkData.Collided.Planars.Empty();
 	WorkData.Collided.PhysBodySpheres.Empty();
 	WorkData.Collided.PhysBodyCapsules.Empty();
+	WorkData.Collided.Compiled.Empty();
+	WorkData.Collided.PhysBodyCompiled.Empty();
 	WorkData.Collided.bValidColliders = false;
 	WorkData.Collided.bValidPhysBodyColliders = false;
 
+	// Anything reading the settings before the first PreUpdate sees the scaled ones
+	ApplyQuality();
+
 	// For Avoiding Zero Divide in the first frame
 	NodeData.LastDeltaTime = MaxPhysicsDeltaTime; 
 
@@ -74,6 +94,11 @@ void FAnimNode_AnimPhys::Initialize_AnyThread(const FAnimationInitializeContext&
 			NodeData.bIsSequencerBound = (OwnerActor->ActorHasTag(SequencerBoundTag) || OwnerActor->ActorHasTag(SequencerActorTag));
 		}
 
+		// Stable across runs, so replays see the same gusts
+		const FString OwnerName = OwnerActor ? OwnerActor->GetName() : Context.AnimInstanceProxy->GetSkelMeshComponent()->GetName();
+		WorkData.Forced.WindNoiseSeed = FCrc::StrCrc32(*OwnerName, static_cast<uint32>(ExternalForceSettings.WindNoiseSeed));
+		WorkData.Forced.WindNoiseStep = 0;
+
 #if WITH_EDITORONLY_DATA
 		UWorld* World = Context.AnimInstanceProxy->GetSkelMeshComponent()->GetWorld();
 		check(World);
@@ -137,9 +162,17 @@ void FAnimNode_AnimPhys::Update_AnyThread(const FAnimationUpdateContext& RESTRIC
 void FAnimNode_AnimPhys::Evaluate_AnyThread(FPoseContext& RESTRICT Output)
 {
 	DECLARE_SCOPE_HIERARCHICAL_COUNTER_ANIMNODE(Evaluate_AnyThread)
+	const bool bAnimPhysValid = IsAnimPhysValid(Output);
+
+	// Solves while the rest of the graph evaluates the input pose
+	if (bAnimPhysValid && IsPipelined(EAnimPhysPipelineLatency::ZeroFrames))
+	{
+		PrepareBeforePose(Output);
+	}
+
 	Base.Evaluate(Output);
 
-	if (IsAnimPhysValid(Output))
+	if (bAnimPhysValid)
 	{
 #if WITH_EDITORONLY_DATA
 		if (EditData.bInEditor)
@@ -161,22 +194,76 @@ void FAnimNode_AnimPhys::EvaluateAnimPhys(FPoseContext& RESTRICT Output)
 {
 	SCOPE_CYCLE_COUNTER(STAT_AnimPhys_Eval);
 
-	if (WorkData.IsInvalidSimulatedBones(Output.Pose))
+	FlushPendingSolve();
+
+	// The wait for a pipelined task is not counted, the task measures its own solve
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+
+	if (WorkData.IsInvalidSimulatedBones(Output.Pose, NodeData.Quality.MaxSimulatedBones, NodeData.LODDecimationStep))
+	{
+		WorkData.BuildSimulatedBones(Output.Pose, BonesToSimulate, BonesToExculude, SetupSettings, NodeData.Quality.MaxSimulatedBones, NodeData.LODDecimationStep, NodeData.Quality.bAngleLimits);
+	}
+	else if (WorkData.Simulated.AngleLimits.bAllowed != NodeData.Quality.bAngleLimits)
 	{
-		WorkData.BuildSimulatedBones(Output.Pose, BonesToSimulate, BonesToExculude, SetupSettings);
+		WorkData.Simulated.AngleLimits.Set(SetupSettings, NodeData.Quality.bAngleLimits);
 	}
 
-	CheckTeleport(Output);
+	if (NodeData.bPreparedBeforePose == false)
+	{
+		CheckTeleport(Output);
+
+		ComputeSkippedTime();
+		ComputeFixedTimeStep();
+		ComputeComponentMovement(Output);
+	}
 
-	ComputeComponentMovement(Output);
 	ComputePoseTransform(Output);
-	ComputeColliderTransform(Output);
+
+	if (NodeData.bSkipStep == false)
+	{
+		ComputeColliderTransform(Output);
+	}
 
 	SimulateBones(Output);
 
 	NodeData.bHasEvaluated = Output.AnimInstanceProxy->GetEvaluationCounter().HasEverBeenUpdated();
 	NodeData.CurrentTeleportType = ETeleportType::None;
 	NodeData.AccumulatedDeltaTime = 0.0f;
+	NodeData.bPreparedBeforePose = false;
+	NodeData.bSolvedBeforePose = false;
+
+	BudgetData.CostCycles += FPlatformTime::Cycles64() - StartCycles;
+}
+
+void FAnimNode_AnimPhys::PrepareBeforePose(FPoseContext& RESTRICT Output)
+{
+	// Needs the bones and the pose of an earlier evaluation
+	if (NodeData.bIsSequencerBound || NodeData.bHasEvaluated == false || WorkData.IsInvalidSimulatedBones(Output.Pose, NodeData.Quality.MaxSimulatedBones, NodeData.LODDecimationStep))
+	{
+		return;
+	}
+
+	FlushPendingSolve();
+
+	CheckTeleport(Output);
+
+	ComputeSkippedTime();
+	ComputeFixedTimeStep();
+	ComputeComponentMovement(Output);
+
+	NodeData.bPreparedBeforePose = true;
+
+	// Resetting to the pose has to wait for the pose, skipped steps only apply the last result
+	if (NodeData.CurrentTeleportType == ETeleportType::ResetPhysics || NodeData.bSkipStep)
+	{
+		return;
+	}
+
+	ComputeEnabledForces();
+	PreparePendingSteps();
+
+	NodeData.bSolvedBeforePose = true;
+	NodeData.PipelinedSolve.Launch([this]() { SolveAndMeasurePendingSteps(); });
 }
 
 bool FAnimNode_AnimPhys::HasPreUpdate() const
@@ -190,35 +277,94 @@ void FAnimNode_AnimPhys::PreUpdate(const UAnimInstance* RESTRICT InAnimInstance)
 {
 	SCOPE_CYCLE_COUNTER(STAT_AnimPhys_PreUpdate);
 
+	// Normally done already, unless the last evaluation was skipped
+	WaitPipelinedSolve();
+
+	IAnimPhysMeshComponentInterface* MeshComponentInterface = Cast<IAnimPhysMeshComponentInterface>(InAnimInstance->GetSkelMeshComponent());
+	if (MeshComponentInterface)
+	{
+		NodeData.AnimPhysDisabledStateByOwner = MeshComponentInterface->GetDesiredAnimPhysDisabledState();
+	}
+
+	if (const USkeletalMeshComponent* SkelMeshComponent = InAnimInstance->GetSkelMeshComponent())
+	{
+		NodeData.PredictedLOD = SkelMeshComponent->GetPredictedLODLevel();
+	}
+
+	// The evaluation would pass the pose through anyway
+	if (IsDormant())
+	{
+		EnterDormant();
+		return;
+	}
+
+	if (NodeData.bDormant)
+	{
+		WakeUp();
+	}
+
 	if(USkeletalMeshComponent* MeshComponent = GetMeshComponent(InAnimInstance->GetSkelMeshComponent()))
 	{
 		if (UWorld* World = MeshComponent->GetWorld())
 		{
 			// Store game time for use in parallel evaluation. This may be the totol time (inc pauses) or the time the game has been unpaused.
 			NodeData.WorldTimeSeconds = MeshComponent->PrimaryComponentTick.bTickEvenWhenPaused ? World->UnpausedTimeSeconds : World->TimeSeconds;
+			NodeData.FrameDeltaSeconds = World->GetDeltaSeconds();
 		}
 			
 		ConditionalSetTeleportType(NodeData.PendingDynamicResetTeleportType, NodeData.CurrentTeleportType);
 		NodeData.PendingDynamicResetTeleportType = ETeleportType::None;
 
+		if (NodeData.Subsystem.IsValid() == false || NodeData.RegisteredNode != this)
+		{
+			NodeData.Subsystem = MeshComponent->GetWorld() ? MeshComponent->GetWorld()->GetSubsystem<UAnimPhysSubsystem>() : nullptr;
+			NodeData.RegisteredNode = this;
+			NodeData.bPendingFrameNode = false;
+
+			if (UAnimPhysSubsystem* Subsystem = NodeData.Subsystem.Get())
+			{
+				Subsystem->RegisterNode(this);
+			}
+		}
+
 		WorkData.Cached.bInterpolated = (MeshComponent->IsUsingExternalInterpolation() || (MeshComponent->ShouldUseUpdateRateOptimizations() && MeshComponent->AnimUpdateRateParams != nullptr && MeshComponent->AnimUpdateRateParams->DoEvaluationRateOptimizations()));
 
-		CopyBoneTransformsFromComponent(MeshComponent);
-		CopyBoneTransformsFromAttachedComponent(MeshComponent);
+		// Without the budget no pass degrades the node, so it is not held back by an old one
+		const bool bCopyBoneTransformsInFramePass = (CVarAnimPhysParallelGather.GetValueOnGameThread() != 0);
+		const bool bBudgetEnabled = UAnimPhysSubsystem::IsBudgetEnabled();
+		if (bBudgetEnabled == false)
+		{
+			BudgetData.Degradation = EAnimPhysDegradation::None;
+			BudgetData.RateDivisor = 1;
+			BudgetData.CostCycles = 0;
+		}
+
+		// Before the gather, so the evaluation coming back on screen gets fresh inputs to catch up with
+		ApplyQuality();
+		ApplyLOD();
+		ApplyBudget();
+		ComputeOffscreen(MeshComponent);
 
-		if (WorkData.Collided.bValidColliders == false)
+		// The subsystem did not copy for this node, first frame or the pass did not run
+		if (NodeData.bBoneTransformsCopied == false)
 		{
-			BuildColliders(MeshComponent);
+			CopyBoneTransformsFromComponent(MeshComponent);
 		}
+		NodeData.bBoneTransformsCopied = false;
 
-		if (CollisionSettings.bCollidedWithSimulatedPhysBody && WorkData.Collided.bValidPhysBodyColliders == false)
+		GatherInputs(MeshComponent);
+
+		// The frame pass copies the bone transforms, measures the node for the budget and waits for a pipelined task an evaluation did not
+		const bool bNeedsFramePass = (bCopyBoneTransformsInFramePass || bBudgetEnabled || SimulationSettings.SolverMode == EAnimPhysSolverMode::Pipelined);
+
+		UAnimPhysSubsystem* Subsystem = NodeData.Subsystem.Get();
+		if (Subsystem && bNeedsFramePass && NodeData.bPendingFrameNode == false)
 		{
-			BuildPhysBodyColliders(MeshComponent);
+			NodeData.bPendingFrameNode = true;
+			Subsystem->EnqueueFrameNode(this, MeshComponent, bCopyBoneTransformsInFramePass);
 		}
 
-		ComputeWind(MeshComponent);
-		ComputePhysBody(MeshComponent);
-		ComputeFloor(MeshComponent);
+		ComputeSimulationRate(MeshComponent);
 
 #if !UE_BUILD_SHIPPING
 		if (CVarDrawDebugAnimPhys.GetValueOnAnyThread())
@@ -235,20 +381,256 @@ void FAnimNode_AnimPhys::PreUpdate(const UAnimInstance* RESTRICT InAnimInstance)
 #endif
 	}
 
-	if (IAnimPhysMeshComponentInterface* MeshComponentInterface = Cast<IAnimPhysMeshComponentInterface>(InAnimInstance->GetSkelMeshComponent()))
+	if (MeshComponentInterface && BonesToSimulate.IsValidIndex(0))
 	{
-		NodeData.AnimPhysDisabledStateByOwner = MeshComponentInterface->GetDesiredAnimPhysDisabledState();
+		WorkData.Forced.Impulse = MeshComponentInterface->GetAccumulatedImpulsesToAnimPhys(BonesToSimulate[0].BoneName);
+	}
+
+	if (NodeData.bIsSequencerBound)
+	{
+		ConditionalSetTeleportType(ETeleportType::TeleportPhysics, NodeData.CurrentTeleportType);
+	}
+
+	// All inputs of the steps are gathered, they are solved until the next evaluation
+	LaunchPipelinedSolve();
+}
+
+void FAnimNode_AnimPhys::GatherInputs(USkeletalMeshComponent* RESTRICT MeshComponent)
+{
+	// Reads the world transforms of both components, which may still move before the evaluation
+	CopyBoneTransformsFromAttachedComponent(MeshComponent);
+
+	if (WorkData.Collided.bValidColliders == false)
+	{
+		BuildColliders(MeshComponent);
+		WorkData.Collided.CachedGeneration = INDEX_NONE;
+	}
+
+	if (CollisionSettings.bCollidedWithSimulatedPhysBody && WorkData.Collided.bValidPhysBodyColliders == false)
+	{
+		BuildPhysBodyColliders(MeshComponent);
+		WorkData.Collided.CachedGeneration = INDEX_NONE;
+	}
+
+	WorkData.ResolveCachedSlots();
+
+	// Only the transforms of the roots are needed while the simulation is skipped
+	if (NodeData.bOffscreen)
+	{
+		return;
+	}
+
+	ComputeWind(MeshComponent);
+	ComputePhysBody(MeshComponent);
+	ComputeFloor(MeshComponent);
+}
+
+void FAnimNode_AnimPhys::EndFrame(USkeletalMeshComponent* RESTRICT MeshComponent, const bool bInCopyBoneTransforms)
+{
+	NodeData.bPendingFrameNode = false;
+
+	// A task launched by PreUpdate keeps running when its evaluation was skipped
+	WaitPipelinedSolve();
+
+	// Component space transforms do not change until the next evaluation
+	if (MeshComponent && bInCopyBoneTransforms)
+	{
+		CopyBoneTransformsFromComponent(MeshComponent);
+		NodeData.bBoneTransformsCopied = true;
+	}
+}
+
+void FAnimNode_AnimPhys::CancelFrameNode()
+{
+	if (NodeData.bPendingFrameNode == false)
+	{
+		return;
+	}
+
+	if (UAnimPhysSubsystem* Subsystem = NodeData.Subsystem.Get())
+	{
+		Subsystem->CancelFrameNode(this);
+	}
+
+	NodeData.bPendingFrameNode = false;
+}
+
+void FAnimNode_AnimPhys::ApplyQuality()
+{
+	NodeData.Quality = AnimPhysQuality::Get();
+
+	const FAnimPhysQuality& Quality = NodeData.Quality;
+	FAnimPhysSimulationSettings& ScaledSettings = NodeData.ScaledSimulationSettings;
+	ScaledSettings = SimulationSettings;
+
+	if (Quality.MaxFixedTimeStepRate > 0.0f)
+	{
+		ScaledSettings.FixedTimeStepRate = FMath::Min(ScaledSettings.FixedTimeStepRate, Quality.MaxFixedTimeStepRate);
+	}
 
-		if(BonesToSimulate.IsValidIndex(0))
+	if (Quality.MaxSubsteps > 0)
+	{
+		ScaledSettings.MaxSubsteps = FMath::Min(ScaledSettings.MaxSubsteps, Quality.MaxSubsteps);
+	}
+
+	if (Quality.MaxConstraintIterations > 0)
+	{
+		ScaledSettings.ConstraintIterations = FMath::Min(ScaledSettings.ConstraintIterations, Quality.MaxConstraintIterations);
+	}
+}
+
+void FAnimNode_AnimPhys::ApplyLOD()
+{
+	NodeData.LODColliderTypes = LODSettings.GetColliderTypes(NodeData.PredictedLOD);
+	NodeData.LODSolverFeatures = LODSettings.GetSolverFeatures(NodeData.PredictedLOD);
+	NodeData.LODDecimationStep = LODSettings.GetDecimationStep(NodeData.PredictedLOD);
+}
+
+void FAnimNode_AnimPhys::ApplyBudget()
+{
+	NodeData.Degradation = BudgetData.Degradation;
+
+	if (NodeData.Degradation >= EAnimPhysDegradation::FewerSubsteps)
+	{
+		NodeData.ScaledSimulationSettings.MaxSubsteps = 1;
+		NodeData.ScaledSimulationSettings.ConstraintIterations = 1;
+		NodeData.ScaledSimulationSettings.MaxCatchUpSteps = 1;
+	}
+
+	NodeData.bSkipStep = (NodeData.Degradation == EAnimPhysDegradation::Frozen)
+		|| (BudgetData.RateDivisor > 1 && ((static_cast<uint32>(GFrameCounter) + BudgetData.RatePhase) % BudgetData.RateDivisor) != 0);
+}
+
+const FAnimPhysSimulationSettings& FAnimNode_AnimPhys::GetSimulationSettings() const
+{
+	return NodeData.ScaledSimulationSettings;
+}
+
+uint32 FAnimNode_AnimPhys::GetColliderTypes() const
+{
+	uint32 ColliderTypes = (NodeData.Quality.ColliderTypes & NodeData.LODColliderTypes);
+	if (CollisionSettings.bCollidedWithSimulatedPhysBody == false)
+	{
+		ColliderTypes &= ~static_cast<uint32>(AnimPhysColliderTypes::PhysBody);
+	}
+
+	return ColliderTypes;
+}
+
+void FAnimNode_AnimPhys::ComputeSimulationRate(const USkeletalMeshComponent* RESTRICT MeshComponent)
+{
+	int32 RateDivisor = FMath::Max(1, SimulationSettings.SimulationRateDivisor);
+	if (SimulationSettings.bSimulationRateFromURO && WorkData.Cached.bInterpolated && MeshComponent->AnimUpdateRateParams)
+	{
+		RateDivisor = FMath::Max(RateDivisor, MeshComponent->AnimUpdateRateParams->UpdateRate);
+	}
+
+	// Without fixed steps the quality cap on the step rate is kept by stepping every few frames instead,
+	// with some headroom so a frame rate just above a multiple of the cap does not change the divisor every frame
+	if (SimulationSettings.bUseFixedTimeStep == false && NodeData.Quality.MaxFixedTimeStepRate > 0.0f && NodeData.FrameDeltaSeconds > 0.0f)
+	{
+		const float FrameRate = 1.0f / NodeData.FrameDeltaSeconds;
+		RateDivisor = FMath::Max(RateDivisor, FMath::CeilToInt(FrameRate / (NodeData.Quality.MaxFixedTimeStepRate * 1.1f)));
+	}
+
+	if (RateDivisor != NodeData.SimulationRateDivisor)
+	{
+		NodeData.SimulationRateDivisor = RateDivisor;
+		NodeData.EvaluationsSinceStep = 0;
+	}
+
+	// Fixed time steps are stretched by the divisor and interpolated as usual
+	if (RateDivisor == 1 || SimulationSettings.bUseFixedTimeStep)
+	{
+		NodeData.EvaluationsSinceStep = 0;
+		NodeData.StepBlendAlpha = 1.0f;
+		return;
+	}
+
+	// Frames whose evaluation was skipped by the update rate optimizations still advance the cadence
+	const uint64 FrameCounter = GFrameCounter;
+	const int32 ElapsedFrames = WorkData.Cached.bInterpolated ? static_cast<int32>(FMath::Clamp<uint64>(FrameCounter - NodeData.LastRateFrameCounter, 1, RateDivisor)) : 1;
+	NodeData.LastRateFrameCounter = FrameCounter;
+
+	if (NodeData.EvaluationsSinceStep > 0)
+	{
+		NodeData.EvaluationsSinceStep += (ElapsedFrames - 1);
+		if (NodeData.EvaluationsSinceStep >= RateDivisor)
 		{
-			WorkData.Forced.Impulse = MeshComponentInterface->GetAccumulatedImpulsesToAnimPhys(BonesToSimulate[0].BoneName);
+			NodeData.EvaluationsSinceStep = 0;
 		}
 	}
 
-	if (NodeData.bIsSequencerBound)
+	const bool bRateStep = (NodeData.EvaluationsSinceStep == 0);
+	if (bRateStep && NodeData.bSkipStep)
 	{
-		ConditionalSetTeleportType(ETeleportType::TeleportPhysics, NodeData.CurrentTeleportType);
+		// Held by the budget, keep showing the last blend until the step happens
+		return;
 	}
+
+	NodeData.bSkipStep |= (bRateStep == false);
+
+	const float StepFraction = static_cast<float>(NodeData.EvaluationsSinceStep) / RateDivisor;
+	NodeData.StepBlendAlpha = SimulationSettings.bExtrapolateBetweenSteps ? (1.0f + StepFraction) : (StepFraction + 1.0f / RateDivisor);
+	NodeData.EvaluationsSinceStep = (NodeData.EvaluationsSinceStep + 1) % RateDivisor;
+}
+
+void FAnimNode_AnimPhys::ComputeOffscreen(const USkeletalMeshComponent* RESTRICT MeshComponent)
+{
+	const bool bOffscreen = (SimulationSettings.bSkipWhileNotRendered && MeshComponent->WasRecentlyRendered() == false);
+	if (bOffscreen && NodeData.bOffscreen == false)
+	{
+		NodeData.OffscreenSinceSeconds = NodeData.WorldTimeSeconds;
+	}
+
+	// Kept until the next evaluation decides how to catch up
+	NodeData.bReturnedOnscreen |= (bOffscreen == false && NodeData.bOffscreen);
+	NodeData.bOffscreen = bOffscreen;
+
+	// Skipped like a budget hold, so the chains are re-anchored at the pose roots instead of left at the last step
+	NodeData.bSkipStep |= bOffscreen;
+}
+
+float FAnimNode_AnimPhys::GetFixedDeltaTime() const
+{
+	return GetSimulationSettings().GetFixedDeltaTime() * NodeData.SimulationRateDivisor;
+}
+
+bool FAnimNode_AnimPhys::IsDormant() const
+{
+	// Alpha is from the last update, a node becoming relevant is woken up one frame later
+	return FAnimWeight::IsRelevant(Alpha) == false
+		|| CVarEnableAnimPhys.GetValueOnGameThread() == 0
+		|| IsDisabledState(EAnimPhysDisabledState::DisableSimulation)
+		|| LODSettings.IsDisabled(NodeData.PredictedLOD);
+}
+
+void FAnimNode_AnimPhys::EnterDormant()
+{
+	if (NodeData.bDormant)
+	{
+		return;
+	}
+
+	NodeData.bDormant = true;
+
+	// Steps left over for the next PreUpdate are dropped, the wake up starts over from the pose
+	NodeData.bPendingPipelinedSolve = false;
+	NodeData.NumPendingSteps = 0;
+	NodeData.bBoneTransformsCopied = false;
+}
+
+void FAnimNode_AnimPhys::WakeUp()
+{
+	NodeData.bDormant = false;
+
+	// Warm starts from the pose like a reset, without the suspension of the evaluation reset
+	ConditionalSetTeleportType(ETeleportType::ResetPhysics, NodeData.CurrentTeleportType);
+	NodeData.LastEvalTimeSeconds = 0.0f;
+	NodeData.SkippedDeltaTime = 0.0f;
+	NodeData.FixedTimeStepAccumulator = 0.0f;
+	NodeData.EvaluationsSinceStep = 0;
+	NodeData.bReturnedOnscreen = false;
 }
 
 void FAnimNode_AnimPhys::ResetDynamics(ETeleportType InTeleportType)
@@ -268,26 +650,28 @@ void FAnimNode_AnimPhys::OnObjectPropertyChanged(UObject* Object, FPropertyChang
 
 void FAnimNode_AnimPhys::ResetSimulatedBones()
 {
-	WorkData.Simulated.SimulatedBones.Empty();
+	WaitPipelinedSolve();
+	NodeData.bBoneTransformsCopied = false;
+	NodeData.PhysBodyGeneration = INDEX_NONE;
 
-	WorkData.Cached.ComponentSpaceTMs.Empty();
-	WorkData.Cached.AttachedComponentSpaceTMs.Empty();
-	WorkData.Cached.NumComponentSpaceTransforms = 0;
-	WorkData.Cached.NumAttachedComponentSpaceTransforms = 0;
-	WorkData.Cached.AttachedMesh = NAME_None;
-	WorkData.Cached.bHasCachedTransforms = false;
+	WorkData.Simulated.Empty();
+
+	WorkData.Cached.Empty();
 
 	WorkData.Collided.Spheres.Empty();
 	WorkData.Collided.Capsules.Empty();
 	WorkData.Collided.Planars.Empty();
 	WorkData.Collided.PhysBodySpheres.Empty();
 	WorkData.Collided.PhysBodyCapsules.Empty();
+	WorkData.Collided.Compiled.Empty();
+	WorkData.Collided.PhysBodyCompiled.Empty();
 	WorkData.Collided.bValidColliders = false;
 	WorkData.Collided.bValidPhysBodyColliders = false;
 }
 
 void FAnimNode_AnimPhys::ResetColliders()
 {
+	NodeData.PhysBodyGeneration = INDEX_NONE;
 	WorkData.Collided.bValidColliders = false;
 	WorkData.Collided.bValidPhysBodyColliders = false;
 }
@@ -320,7 +704,7 @@ bool FAnimNode_AnimPhys::IsAnimPhysValid(const FPoseContext& RESTRICT Context) c
 		return false;
 	}
 
-	if (NodeData.AnimPhysDisabledStateByOwner == EAnimPhysDisabledState::DisableAll)
+	if (NodeData.bDormant || IsDisabledState(EAnimPhysDisabledState::DisableSimulation))
 	{
 		return false;
 	}
@@ -449,16 +833,9 @@ void FAnimNode_AnimPhys::BuildCachedTransformIndexes(USkeletalMeshComponent* RES
 
 	BoneMap.Remove(INDEX_NONE);
 
-	const int32 NumBones = RefSkeleton.GetNum();
-	WorkData.Cached.NumComponentSpaceTransforms = NumBones;
-	WorkData.Cached.ComponentSpaceTMs.Empty(BoneMap.Num());
-
 	TArray<int32> ComponentSpaceIndexes;
-	BoneMap.GenerateKeyArray(ComponentSpaceIndexes);	
-	for (int32 ComponentSpaceIndex : ComponentSpaceIndexes)
-	{
-		WorkData.Cached.ComponentSpaceTMs.Add(FMeshPoseBoneIndex(ComponentSpaceIndex), FTransform::Identity);
-	}
+	BoneMap.GenerateKeyArray(ComponentSpaceIndexes);
+	WorkData.Cached.SetBoneIndexes(ComponentSpaceIndexes, RefSkeleton.GetNum());
 
 	WorkData.Collided.bValidColliders = false;
 }
@@ -516,17 +893,11 @@ void FAnimNode_AnimPhys::BuildCachedAttachedTransformIndexes(USkeletalMeshCompon
 
 	AttachedBoneMap.Remove(INDEX_NONE);
 
-	const int32 NumBones = AttachedRefSkeleton.GetNum();
-	WorkData.Cached.NumAttachedComponentSpaceTransforms = NumBones;
-	WorkData.Cached.AttachedComponentSpaceTMs.Empty(AttachedBoneMap.Num());
 	WorkData.Cached.AttachedMesh = AttachedMeshAsset->GetFName();
 
 	TArray<int32> ComponentSpaceIndexes;
 	AttachedBoneMap.GenerateKeyArray(ComponentSpaceIndexes);
-	for (int32 ComponentSpaceIndex : ComponentSpaceIndexes)
-	{
-		WorkData.Cached.AttachedComponentSpaceTMs.Add(FMeshPoseBoneIndex(ComponentSpaceIndex), FTransform::Identity);
-	}
+	WorkData.Cached.SetAttachedBoneIndexes(ComponentSpaceIndexes, AttachedRefSkeleton.GetNum());
 
 	WorkData.Collided.bValidColliders = false;
 }
@@ -549,13 +920,12 @@ void FAnimNode_AnimPhys::CopyBoneTransformsFromComponent(USkeletalMeshComponent*
 		BuildCachedTransformIndexes(MeshComponent);
 	}
 
-	for (auto& CachedComponentSpaceTM : WorkData.Cached.ComponentSpaceTMs)
+	// Slots were built from bones of this mesh, so every index is in range
+	const FAnimPhys_CompiledCacheSlots& SlotTable = *WorkData.Cached.SlotTable;
+	const int32 NumSlots = WorkData.Cached.ComponentSpaceTMs.Num();
+	for (int32 Slot = 0; Slot < NumSlots; ++Slot)
 	{
-		const FMeshPoseBoneIndex& ComponentSpaceIndex = CachedComponentSpaceTM.Key;
-		if (ComponentSpaceTMs.IsValidIndex(ComponentSpaceIndex.GetInt()))
-		{
-			CachedComponentSpaceTM.Value = ComponentSpaceTMs[ComponentSpaceIndex.GetInt()];
-		}
+		WorkData.Cached.ComponentSpaceTMs[Slot] = ComponentSpaceTMs[SlotTable.BoneIndexes[Slot].GetInt()];
 	}
 
 	const int32 RootBoneIndex(0);
@@ -593,13 +963,11 @@ void FAnimNode_AnimPhys::CopyBoneTransformsFromAttachedComponent(USkeletalMeshCo
 
 	FTransform BaseTM = AttachedMeshComponent->GetComponentTransform().GetRelativeTransform(MeshComponent->GetComponentTransform());
 
-	for (auto& CachedAttachedComponentSpaceTM : WorkData.Cached.AttachedComponentSpaceTMs)
+	const FAnimPhys_CompiledCacheSlots& SlotTable = *WorkData.Cached.AttachedSlotTable;
+	const int32 NumSlots = WorkData.Cached.AttachedComponentSpaceTMs.Num();
+	for (int32 Slot = 0; Slot < NumSlots; ++Slot)
 	{
-		const FMeshPoseBoneIndex& ComponentSpaceIndex = CachedAttachedComponentSpaceTM.Key;
-		if (AttachedComponentSpaceTMs.IsValidIndex(ComponentSpaceIndex.GetInt()))
-		{
-			CachedAttachedComponentSpaceTM.Value = AttachedComponentSpaceTMs[ComponentSpaceIndex.GetInt()] * BaseTM;
-		}
+		WorkData.Cached.AttachedComponentSpaceTMs[Slot] = AttachedComponentSpaceTMs[SlotTable.BoneIndexes[Slot].GetInt()] * BaseTM;
 	}
 }
 
@@ -637,7 +1005,7 @@ void FAnimNode_AnimPhys::ComputeWind(const USkeletalMeshComponent* RESTRICT Mesh
 {
 	if (IsWindEnabled(MeshComponent))
 	{
-		FVector BoneWorldPosition = WorkData.Simulated.SimulatedBones.IsValidIndex(0) ? WorkData.Simulated.SimulatedBones[0].PoseComponentSpaceTM.GetLocation() : FVector::ZeroVector;
+		FVector BoneWorldPosition = WorkData.Simulated.IsValidIndex(0) ? WorkData.Simulated.PoseLocations[0] : FVector::ZeroVector;
 		BoneWorldPosition = MeshComponent->GetComponentTransform().TransformPosition(BoneWorldPosition);
 
 		FVector WindDirection = FVector::ZeroVector;
@@ -705,7 +1073,61 @@ void FAnimNode_AnimPhys::ComputeComponentMovement(FPoseContext& RESTRICT Output)
 		WorkData.Moved.WorldRotationDelta = FQuat::Identity;
 	}
 
-	WorkData.Moved.LastComponentTransform = ComponentTransform;
+	// Keep accumulating the movement until a fixed step consumes it
+	const bool bConsumesMovement = (NodeData.CurrentTeleportType != ETeleportType::None)
+		|| (NodeData.bSkipStep == false && (SimulationSettings.bUseFixedTimeStep == false || NodeData.NumFixedTimeSteps > 0));
+	if (bConsumesMovement)
+	{
+		WorkData.Moved.LastComponentTransform = ComponentTransform;
+	}
+}
+
+void FAnimNode_AnimPhys::ComputeSkippedTime()
+{
+	NodeData.NumCatchUpSteps = 1;
+
+	if (NodeData.bSkipStep)
+	{
+		NodeData.SkippedDeltaTime += NodeData.AccumulatedDeltaTime;
+		NodeData.AccumulatedDeltaTime = 0.0f;
+		return;
+	}
+
+	// Catch up on the time of the skipped evaluations in a few large steps, within the limits of a single step each
+	if (NodeData.SkippedDeltaTime > 0.0f)
+	{
+		const float CatchUpTime = NodeData.DeltaTime + NodeData.SkippedDeltaTime;
+		// The evaluations skipped by the simulation rate are always caught up with
+		const int32 MaxCatchUpSteps = FMath::Max3(1, GetSimulationSettings().MaxCatchUpSteps, NodeData.SimulationRateDivisor);
+		NodeData.NumCatchUpSteps = FMath::Clamp(FMath::CeilToInt32(CatchUpTime / MaxPhysicsDeltaTime), 1, MaxCatchUpSteps);
+
+		NodeData.AccumulatedDeltaTime += NodeData.SkippedDeltaTime;
+		NodeData.DeltaTime = FMath::Min(MaxPhysicsDeltaTime, CatchUpTime / NodeData.NumCatchUpSteps);
+		NodeData.SkippedDeltaTime = 0.0f;
+	}
+}
+
+void FAnimNode_AnimPhys::ComputeFixedTimeStep()
+{
+	NodeData.NumFixedTimeSteps = 0;
+	NodeData.FixedTimeStepAlpha = 1.0f;
+
+	if (SimulationSettings.bUseFixedTimeStep == false)
+	{
+		NodeData.FixedTimeStepAccumulator = 0.0f;
+		return;
+	}
+
+	const float FixedDeltaTime = GetFixedDeltaTime();
+
+	NodeData.FixedTimeStepAccumulator += NodeData.AccumulatedDeltaTime;
+	NodeData.NumFixedTimeSteps = FMath::FloorToInt32(NodeData.FixedTimeStepAccumulator / FixedDeltaTime);
+	NodeData.FixedTimeStepAccumulator -= (NodeData.NumFixedTimeSteps * FixedDeltaTime);
+
+	// Drop the time that can not be caught up with instead of spiraling
+	NodeData.NumFixedTimeSteps = FMath::Min(NodeData.NumFixedTimeSteps, FMath::Max(1, GetSimulationSettings().MaxSubsteps));
+
+	NodeData.FixedTimeStepAlpha = FMath::Clamp(NodeData.FixedTimeStepAccumulator / FixedDeltaTime, 0.0f, 1.0f);
 }
 
 void FAnimNode_AnimPhys::ComputePoseTransform(FPoseContext& RESTRICT Output)
@@ -719,80 +1141,336 @@ void FAnimNode_AnimPhys::ComputePoseTransform(FPoseContext& RESTRICT Output)
 	const bool bResetDynamics = (NodeData.CurrentTeleportType == ETeleportType::ResetPhysics);
 	const FBoneContainer& RequiredBones = Output.Pose.GetBoneContainer();
 
-	for (auto& Bone : WorkData.Simulated.SimulatedBones)
+	WorkData.Simulated.ValidDecimatedBones.SetRange(0, WorkData.Simulated.ValidDecimatedBones.Num(), false);
+
+	for (int32 BoneIndex = 0; BoneIndex < WorkData.Simulated.Num(); ++BoneIndex)
 	{
-		Bone.CompactPoseBoneIndex = RequiredBones.MakeCompactPoseIndex(Bone.MeshPoseBoneIndex);	
-		Bone.bValid = false;
+		WorkData.Simulated.CompactPoseBoneIndexes[BoneIndex] = RequiredBones.MakeCompactPoseIndex(WorkData.Simulated.Topology[BoneIndex].MeshPoseBoneIndex);
+		WorkData.Simulated.ValidBones[BoneIndex] = false;
 
-		WorkData.CalculatePoseComponentSpace(Output.Pose, SetupSettings, Bone);
+		WorkData.CalculatePoseComponentSpace(Output.Pose, SetupSettings, BoneIndex);
 
-		if (Bone.bValid == false)
+		if (WorkData.Simulated.ValidBones[BoneIndex] == false)
 		{
 			continue;
 		}
 
 		if (bResetDynamics)
 		{
-			Bone.ComponentSpaceTM = Bone.PoseComponentSpaceTM;
-			Bone.PrevLocation = Bone.PoseComponentSpaceTM.GetLocation();
+			WorkData.Simulated.ResetToPose(BoneIndex);
 		}
 	}
+
+	WorkData.CalculateDecimatedPoseComponentSpace(Output.Pose);
+
+	if (bResetDynamics)
+	{
+		WorkData.Simulated.WakeAllChains();
+	}
 }
 
-void FAnimNode_AnimPhys::SimulateBones(FPoseContext& RESTRICT Output)
+DECLARE_DWORD_COUNTER_STAT(TEXT("AnimPhys_ConstraintIterations"), STAT_AnimPhys_ConstraintIterations, STATGROUP_Anim);
+
+void FAnimNode_AnimPhys::ComputeEnabledForces()
 {
 	WorkData.Simulated.bDampingEnabled = IsEnableDamping();
 	WorkData.Simulated.bStiffnessEnabled = IsEnableStiffness();
 	WorkData.Simulated.bGravityEnabled = IsEnableGravity();
 	WorkData.Simulated.bWindEnabled = IsEnableWind();
 	WorkData.Simulated.bWorldDampingEnabled = IsEnableWorldDamping();
+	WorkData.Simulated.AllowedFeatures = NodeData.LODSolverFeatures;
+}
+
+void FAnimNode_AnimPhys::SimulateBones(FPoseContext& RESTRICT Output)
+{
+	// The steps of this evaluation were solved while the input pose was evaluated
+	if (NodeData.bSolvedBeforePose)
+	{
+		WorkData.ApplySimulateBones(Output.Pose, GetBlendAlpha());
+		NodeData.LastBlendAlpha = GetBlendAlpha();
+		return;
+	}
+
+	const bool NeedsToWarmUp = (NodeData.bIsSequencerBound && NodeData.bHasEvaluated == false && EvaluationWarmUpTime > 0.0f);
+
+	UAnimPhysSubsystem* BatchedSolver = (SimulationSettings.SolverMode == EAnimPhysSolverMode::Batched && NeedsToWarmUp == false) ? NodeData.Subsystem.Get() : nullptr;
+	const bool bDeferredSolve = (BatchedSolver || (IsPipelined(EAnimPhysPipelineLatency::OneFrame) && NeedsToWarmUp == false));
+
+	// Apply what the last batch or task solved, the steps of this evaluation are applied by the next one
+	if (bDeferredSolve)
+	{
+		WorkData.ApplySimulateBones(Output.Pose, NodeData.LastBlendAlpha, NodeData.bSkipStep);
+	}
+
+	// Held by the budget or off screen, the time is stepped by a later evaluation. The chains follow the roots of the current pose meanwhile,
+	// shadows, reflections and attached actors still read this pose off screen
+	if (NodeData.bSkipStep)
+	{
+		if (bDeferredSolve == false)
+		{
+			WorkData.ApplySimulateBones(Output.Pose, GetBlendAlpha(), true);
+		}
+
+		NodeData.LastBlendAlpha = GetBlendAlpha();
+		return;
+	}
 
-	int32 MaxIterations = 1;
+	ComputeEnabledForces();
 
+	if (BatchedSolver)
+	{
+		PreparePendingSteps();
+		NodeData.LastBlendAlpha = GetBlendAlpha();
+
+		NodeData.bPendingBatchedSolve = true;
+		BatchedSolver->Submit(this);
+		return;
+	}
+
+	if (bDeferredSolve)
+	{
+		// Launched by the next PreUpdate
+		PreparePendingSteps();
+		NodeData.LastBlendAlpha = GetBlendAlpha();
+
+		NodeData.bPendingPipelinedSolve = true;
+		return;
+	}
+
+	PreparePendingSteps();
+	SolvePendingSteps();
+
+	WorkData.ApplySimulateBones(Output.Pose, GetBlendAlpha());
+	NodeData.LastBlendAlpha = GetBlendAlpha();
+}
+
+float FAnimNode_AnimPhys::GetBlendAlpha() const
+{
+	return NodeData.bPendingFixedSteps ? NodeData.FixedTimeStepAlpha : NodeData.StepBlendAlpha;
+}
+
+void FAnimNode_AnimPhys::PreparePendingSteps()
+{
 	const bool NeedsToWarmUp = (NodeData.bIsSequencerBound && NodeData.bHasEvaluated == false && EvaluationWarmUpTime > 0.0f);
 	if (NeedsToWarmUp)
 	{
-		MaxIterations = (EvaluationWarmUpTime / MaxPhysicsDeltaTime);
 		NodeData.DeltaTime = MaxPhysicsDeltaTime;
 	}
 
-	for(int32 NumIterations = 0; NumIterations< MaxIterations; ++NumIterations)
+	// The steps may be solved on another thread while the settings are updated by the next graph update
+	NodeData.PendingSetupSettings = SetupSettings;
+	NodeData.PendingExternalForceSettings = ExternalForceSettings;
+	NodeData.PendingSmoothingSettings = SmoothingSettings;
+	NodeData.PendingSimulationSettings = GetSimulationSettings();
+
+	NodeData.bPendingFixedSteps = (SimulationSettings.bUseFixedTimeStep && NeedsToWarmUp == false);
+	NodeData.bPendingStepBlend = (NodeData.SimulationRateDivisor > 1 && NodeData.bPendingFixedSteps == false && NeedsToWarmUp == false);
+
+	if (NodeData.bPendingFixedSteps)
 	{
-		WorkData.SimulateBones(Output.Pose, NodeData.DeltaTime, NodeData.LastDeltaTime, TargetFramerate, SetupSettings, ExternalForceSettings, SmoothingSettings);
+		const float FixedDeltaTime = GetFixedDeltaTime();
+
+		// Spread the movement since the last step over the steps of this evaluation
+		if (NodeData.NumFixedTimeSteps > 1)
+		{
+			const float StepFraction = 1.0f / NodeData.NumFixedTimeSteps;
+			WorkData.Moved.WorldLocationDelta *= StepFraction;
+			WorkData.Moved.WorldRotationDelta = FQuat::Slerp(FQuat::Identity, WorkData.Moved.WorldRotationDelta, StepFraction);
+		}
+
+		NodeData.NumPendingSteps = NodeData.NumFixedTimeSteps;
+		NodeData.PendingDeltaTime = FixedDeltaTime;
+		NodeData.PendingLastDeltaTime = FixedDeltaTime;
 
-		NodeData.LastDeltaTime = NodeData.DeltaTime;
+		NodeData.LastDeltaTime = FixedDeltaTime;
+		return;
 	}
 
-	WorkData.ApplySimulateBones(Output.Pose);
+	NodeData.NumPendingSteps = NeedsToWarmUp ? static_cast<int32>(EvaluationWarmUpTime / MaxPhysicsDeltaTime) : NodeData.NumCatchUpSteps;
+	NodeData.PendingDeltaTime = NodeData.DeltaTime;
+	NodeData.PendingLastDeltaTime = NodeData.LastDeltaTime;
+
+	NodeData.LastDeltaTime = NodeData.DeltaTime;
 }
 
-const bool FAnimNode_AnimPhys::IsDisabledState(EAnimPhysDisabledState InState) const
+void FAnimNode_AnimPhys::SolvePendingSteps()
 {
-	if ((NodeData.AnimPhysDisabledStateByOwner & InState) == EAnimPhysDisabledState::None)
+	NodeData.bPendingBatchedSolve = false;
+
+	for (int32 NumSteps = 0; NumSteps < NodeData.NumPendingSteps; ++NumSteps)
 	{
-		return false;
+		if (NodeData.bPendingFixedSteps || (NodeData.bPendingStepBlend && NumSteps == 0))
+		{
+			WorkData.Simulated.LastStepLocations = WorkData.Simulated.Locations;
+		}
+
+		WorkData.SimulateBones(NodeData.PendingDeltaTime, NodeData.PendingLastDeltaTime, TargetFramerate, NodeData.PendingSetupSettings, NodeData.PendingExternalForceSettings, NodeData.PendingSmoothingSettings, NodeData.PendingSimulationSettings);
+		INC_DWORD_STAT_BY(STAT_AnimPhys_ConstraintIterations, WorkData.Simulated.NumConstraintIterations);
+
+		NodeData.PendingLastDeltaTime = NodeData.PendingDeltaTime;
 	}
 
-	return true;
+	if (NodeData.bPendingFixedSteps == false && NodeData.bPendingStepBlend == false)
+	{
+		WorkData.Simulated.LastStepLocations.Reset();
+	}
+
+	NodeData.NumPendingSteps = 0;
 }
 
-const bool FAnimNode_AnimPhys::IsEnableDamping() const
+bool FAnimNode_AnimPhys::CanSolveInLanesWith(const FAnimNode_AnimPhys& InOther) const
+{
+	return FAnimPhys_LaneBatch::CanShareLanes(WorkData, InOther.WorkData)
+		&& NodeData.NumPendingSteps == InOther.NodeData.NumPendingSteps
+		&& NodeData.bPendingFixedSteps == InOther.NodeData.bPendingFixedSteps;
+}
+
+void FAnimNode_AnimPhys::SolvePendingStepsInLanes(TConstArrayView<FAnimNode_AnimPhys*> InNodes)
 {
-	if (IsDisabledState(EAnimPhysDisabledState::DisableSimulation))
+	if (InNodes.Num() == 1)
 	{
-		return false;
+		InNodes[0]->SolvePendingSteps();
+		return;
 	}
 
-	return (NodeData.DeltaTime <= MaxPhysicsDeltaTime);
+	FAnimPhys_LaneBatch LaneBatch;
+	for (FAnimNode_AnimPhys* Node : InNodes)
+	{
+		check(Node->CanSolveInLanesWith(*InNodes[0]));
+
+		Node->NodeData.bPendingBatchedSolve = false;
+		LaneBatch.Lanes.Add(&Node->WorkData);
+	}
+
+	const int32 NumPendingSteps = InNodes[0]->NodeData.NumPendingSteps;
+	const bool bPendingFixedSteps = InNodes[0]->NodeData.bPendingFixedSteps;
+
+	for (int32 NumSteps = 0; NumSteps < NumPendingSteps; ++NumSteps)
+	{
+		FAnimPhys_SolverParams Params[FAnimPhys_LaneBatch::NumLanes];
+		TArray<const FAnimPhys_SolverParams*, TInlineAllocator<FAnimPhys_LaneBatch::NumLanes>> LaneParams;
+
+		for (int32 Lane = 0; Lane < InNodes.Num(); ++Lane)
+		{
+			FAnimNode_AnimPhys& Node = *InNodes[Lane];
+			if (bPendingFixedSteps || (Node.NodeData.bPendingStepBlend && NumSteps == 0))
+			{
+				Node.WorkData.Simulated.LastStepLocations = Node.WorkData.Simulated.Locations;
+			}
+
+			const bool bPrepared = Node.WorkData.PrepareSimulateBones(Node.NodeData.PendingDeltaTime, Node.NodeData.PendingLastDeltaTime, TargetFramerate, Node.NodeData.PendingSetupSettings, Node.NodeData.PendingExternalForceSettings, Node.NodeData.PendingSmoothingSettings, Node.NodeData.PendingSimulationSettings, Params[Lane]);
+			LaneParams.Add(bPrepared ? &Params[Lane] : nullptr);
+		}
+
+		LaneBatch.SimulateBones(LaneParams);
+
+		for (int32 Lane = 0; Lane < InNodes.Num(); ++Lane)
+		{
+			FAnimNode_AnimPhys& Node = *InNodes[Lane];
+			if (LaneParams[Lane])
+			{
+				Node.WorkData.Simulated.NumConstraintIterations = Node.WorkData.RelaxConstraints(Node.NodeData.PendingSimulationSettings.ConstraintIterations, Node.NodeData.PendingSimulationSettings.ConstraintTolerance);
+				INC_DWORD_STAT_BY(STAT_AnimPhys_ConstraintIterations, Node.WorkData.Simulated.NumConstraintIterations);
+			}
+
+			Node.NodeData.PendingLastDeltaTime = Node.NodeData.PendingDeltaTime;
+		}
+	}
+
+	for (FAnimNode_AnimPhys* Node : InNodes)
+	{
+		if (bPendingFixedSteps == false && Node->NodeData.bPendingStepBlend == false)
+		{
+			Node->WorkData.Simulated.LastStepLocations.Reset();
+		}
+
+		Node->NodeData.NumPendingSteps = 0;
+	}
 }
 
-const bool FAnimNode_AnimPhys::IsEnableStiffness() const
+void FAnimNode_AnimPhys::FlushPendingSolve()
+{
+	WaitPipelinedSolve();
+
+	// Nothing got to the steps of the last evaluation
+	if (NodeData.bPendingBatchedSolve || NodeData.bPendingPipelinedSolve)
+	{
+		CancelBatchedSolve();
+		NodeData.bPendingPipelinedSolve = false;
+		SolveAndMeasurePendingSteps();
+	}
+}
+
+void FAnimNode_AnimPhys::CancelBatchedSolve()
+{
+	if (NodeData.bPendingBatchedSolve == false)
+	{
+		return;
+	}
+
+	if (UAnimPhysSubsystem* BatchedSolver = NodeData.Subsystem.Get())
+	{
+		BatchedSolver->Cancel(this);
+	}
+
+	NodeData.bPendingBatchedSolve = false;
+}
+
+bool FAnimNode_AnimPhys::IsPipelined(const EAnimPhysPipelineLatency InLatency) const
+{
+	return SimulationSettings.SolverMode == EAnimPhysSolverMode::Pipelined && SimulationSettings.PipelineLatency == InLatency;
+}
+
+void FAnimNode_AnimPhys::LaunchPipelinedSolve()
+{
+	if (NodeData.bPendingPipelinedSolve == false)
+	{
+		return;
+	}
+
+	NodeData.bPendingPipelinedSolve = false;
+	NodeData.PipelinedSolve.Launch([this]() { SolveAndMeasurePendingSteps(); });
+}
+
+void FAnimNode_AnimPhys::SolveAndMeasurePendingSteps()
+{
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+
+	SolvePendingSteps();
+
+	BudgetData.CostCycles += FPlatformTime::Cycles64() - StartCycles;
+}
+
+DECLARE_CYCLE_STAT(TEXT("AnimPhys_PipelineWait"), STAT_AnimPhys_PipelineWait, STATGROUP_Anim);
+
+void FAnimNode_AnimPhys::WaitPipelinedSolve()
 {
-	if (IsDisabledState(EAnimPhysDisabledState::DisableSimulation))
+	if (NodeData.PipelinedSolve.IsValid() == false)
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_AnimPhys_PipelineWait);
+	NodeData.PipelinedSolve.Wait();
+}
+
+const bool FAnimNode_AnimPhys::IsDisabledState(EAnimPhysDisabledState InState) const
+{
+	if ((NodeData.AnimPhysDisabledStateByOwner & InState) == EAnimPhysDisabledState::None)
 	{
 		return false;
 	}
 
+	return true;
+}
+
+const bool FAnimNode_AnimPhys::IsEnableDamping() const
+{
+	return (NodeData.DeltaTime <= MaxPhysicsDeltaTime);
+}
+
+const bool FAnimNode_AnimPhys::IsEnableStiffness() const
+{
 	return (NodeData.bPhysBodyWasSimulated == false);
 }
 
@@ -818,17 +1496,13 @@ const bool FAnimNode_AnimPhys::IsEnableWind() const
 
 const bool FAnimNode_AnimPhys::IsEnableWorldDamping() const
 {
-	if (IsDisabledState(EAnimPhysDisabledState::DisableSimulation))
-	{
-		return false;
-	}
-
-	return  (NodeData.CurrentTeleportType == ETeleportType::None);
+	return (NodeData.CurrentTeleportType == ETeleportType::None);
 }
 
 bool FAnimNode_AnimPhys::TryGetCollisionComponentSpaceTransform(FTransform& RESTRICT ComponentSpaceTM, const FAnimPhys_CollidedBase_WorkData& RESTRICT Collider) const
 {
-	if (Collider.MeshPoseBoneIndex.IsValid() == false)
+	const FAnimPhys_ColliderDefinition& Definition = *Collider.Definition;
+	if (Definition.MeshPoseBoneIndex.IsValid() == false)
 	{
 		return false;
 	}
@@ -838,36 +1512,23 @@ bool FAnimNode_AnimPhys::TryGetCollisionComponentSpaceTransform(FTransform& REST
 		return false;
 	}
 
-	if (Collider.bFromAttachedMesh)
+	const TArray<FTransform>& CachedTMs = Definition.bFromAttachedMesh ? WorkData.Cached.AttachedComponentSpaceTMs : WorkData.Cached.ComponentSpaceTMs;
+	if (CachedTMs.IsValidIndex(Collider.CachedSlot) == false)
 	{
-		const FTransform* Found = WorkData.Cached.AttachedComponentSpaceTMs.Find(Collider.MeshPoseBoneIndex);
-		if (Found == nullptr)
-		{
-			return false;
-		}
-
-		ComponentSpaceTM = (*Found);
+		return false;
 	}
-	else
-	{
-		const FTransform* Found = WorkData.Cached.ComponentSpaceTMs.Find(Collider.MeshPoseBoneIndex);
-		if (Found == nullptr)
-		{
-			return false;
-		}
 
-		ComponentSpaceTM = (*Found);
-	}
+	ComponentSpaceTM = CachedTMs[Collider.CachedSlot];
 
-	if (Collider.bHasOffset)
+	if (Definition.bHasOffset)
 	{
-		ComponentSpaceTM = Collider.OffsetTransform * ComponentSpaceTM;
+		ComponentSpaceTM = Definition.OffsetTransform * ComponentSpaceTM;
 	}
 
 	return true;
 }
 
-void FAnimNode_AnimPhys::BuildSphereColliders(const FReferenceSkeleton& RefSkeleton, const bool bFromAttachedMesh, const TArray<FAnimPhysSphereCollider>& SphereColliders)
+void FAnimNode_AnimPhys::BuildSphereColliders(FAnimPhys_CompiledColliders& OutColliders, const FReferenceSkeleton& RefSkeleton, const bool bFromAttachedMesh, const TArray<FAnimPhysSphereCollider>& SphereColliders) const
 {
 	for (const auto& Sphere : SphereColliders)
 	{
@@ -877,7 +1538,7 @@ void FAnimNode_AnimPhys::BuildSphereColliders(const FReferenceSkeleton& RefSkele
 			continue;
 		}
 
-		FAnimPhys_CollidedSphere_WorkData CollidedSphere;
+		FAnimPhys_ColliderDefinition CollidedSphere;
 		CollidedSphere.MeshPoseBoneIndex = MeshPoseBoneIndex;
 		CollidedSphere.LimitDistance = SetupSettings.Radius + Sphere.Radius;
 		CollidedSphere.LimitDistanceSquared = (CollidedSphere.LimitDistance * CollidedSphere.LimitDistance);
@@ -893,11 +1554,11 @@ void FAnimNode_AnimPhys::BuildSphereColliders(const FReferenceSkeleton& RefSkele
 		CollidedSphere.DebugRadius = Sphere.Radius;
 #endif
 
-		WorkData.Collided.Spheres.Add(CollidedSphere);
+		OutColliders.Spheres.Add(CollidedSphere);
 	}
 }
 
-void FAnimNode_AnimPhys::BuildCapsuleColliders(const FReferenceSkeleton& RefSkeleton, const bool bFromAttachedMesh, const TArray<FAnimPhysCapsuleCollider>& CapsuleColliders)
+void FAnimNode_AnimPhys::BuildCapsuleColliders(FAnimPhys_CompiledColliders& OutColliders, const FReferenceSkeleton& RefSkeleton, const bool bFromAttachedMesh, const TArray<FAnimPhysCapsuleCollider>& CapsuleColliders) const
 {
 	for (const auto& Capsule : CapsuleColliders)
 	{
@@ -907,7 +1568,7 @@ void FAnimNode_AnimPhys::BuildCapsuleColliders(const FReferenceSkeleton& RefSkel
 			continue;
 		}
 
-		FAnimPhys_CollidedCapsule_WorkData CollidedCapsule;
+		FAnimPhys_ColliderDefinition CollidedCapsule;
 		CollidedCapsule.MeshPoseBoneIndex = MeshPoseBoneIndex;
 		CollidedCapsule.LimitDistance = SetupSettings.Radius + Capsule.Radius;
 		CollidedCapsule.LimitDistanceSquared = (CollidedCapsule.LimitDistance * CollidedCapsule.LimitDistance);
@@ -929,11 +1590,11 @@ void FAnimNode_AnimPhys::BuildCapsuleColliders(const FReferenceSkeleton& RefSkel
 		CollidedCapsule.DebugRadius = Capsule.Radius;
 #endif
 
-		WorkData.Collided.Capsules.Add(CollidedCapsule);
+		OutColliders.Capsules.Add(CollidedCapsule);
 	}
 }
 
-void FAnimNode_AnimPhys::BuildPlanarColliders(const FReferenceSkeleton& RefSkeleton, const bool bFromAttachedMesh, const TArray<FAnimPhysPlanarCollider>& PlanarColliders)
+void FAnimNode_AnimPhys::BuildPlanarColliders(FAnimPhys_CompiledColliders& OutColliders, const FReferenceSkeleton& RefSkeleton, const bool bFromAttachedMesh, const TArray<FAnimPhysPlanarCollider>& PlanarColliders) const
 {
 	const float PlanarDepth = FMath::Max(1.0f, SetupSettings.Radius);
 
@@ -945,7 +1606,7 @@ void FAnimNode_AnimPhys::BuildPlanarColliders(const FReferenceSkeleton& RefSkele
 			continue;
 		}
 
-		FAnimPhys_CollidedPlanar_WorkData CollidedPlanar;
+		FAnimPhys_ColliderDefinition CollidedPlanar;
 		CollidedPlanar.MeshPoseBoneIndex = MeshPoseBoneIndex;
 		CollidedPlanar.LimitDistance = PlanarDepth;
 		CollidedPlanar.LimitDistanceSquared = (PlanarDepth * PlanarDepth);
@@ -962,10 +1623,44 @@ void FAnimNode_AnimPhys::BuildPlanarColliders(const FReferenceSkeleton& RefSkele
 			CollidedPlanar.bHasOffset = true;
 		}
 
-		WorkData.Collided.Planars.Add(CollidedPlanar);
+		OutColliders.Planars.Add(CollidedPlanar);
 	}
 }
 
+namespace AnimPhysColliders
+{
+	template <typename CollidedType>
+	static void AddDefinitions(TArray<CollidedType>& OutCollided, const TArray<FAnimPhys_ColliderDefinition>& InDefinitions)
+	{
+		OutCollided.Reserve(OutCollided.Num() + InDefinitions.Num());
+		for (const FAnimPhys_ColliderDefinition& Definition : InDefinitions)
+		{
+			OutCollided.AddDefaulted_GetRef().Definition = &Definition;
+		}
+	}
+}
+
+void FAnimNode_AnimPhys::AddCompiledColliders(const USkeletalMesh* SkeletalMesh, const UAnimPhysCollisionData* CollisionData, const bool bFromAttachedMesh, const TArray<FAnimPhysSphereCollider>& SphereColliders, const TArray<FAnimPhysCapsuleCollider>& CapsuleColliders, const TArray<FAnimPhysPlanarCollider>& PlanarColliders)
+{
+	// Instances on the same mesh and colliders resolve the driving bones once, the shapes are part of the key so edited colliders compile again
+	FAnimPhys_CompiledCollidersKey Key(SkeletalMesh, CollisionData, SetupSettings.Radius, 0.0f, bFromAttachedMesh);
+	Key.AddColliders(SphereColliders, CapsuleColliders, PlanarColliders);
+
+	const FAnimPhys_CompiledCollidersPtr Compiled = AnimPhysCompiledSetup::FindOrCompileColliders(Key, [&](FAnimPhys_CompiledColliders& OutColliders)
+	{
+		const FReferenceSkeleton& RefSkeleton = SkeletalMesh->GetRefSkeleton();
+		BuildSphereColliders(OutColliders, RefSkeleton, bFromAttachedMesh, SphereColliders);
+		BuildCapsuleColliders(OutColliders, RefSkeleton, bFromAttachedMesh, CapsuleColliders);
+		BuildPlanarColliders(OutColliders, RefSkeleton, bFromAttachedMesh, PlanarColliders);
+	});
+
+	// The work data only keeps the transforms and the collision state written every frame
+	AnimPhysColliders::AddDefinitions(WorkData.Collided.Spheres, Compiled->Spheres);
+	AnimPhysColliders::AddDefinitions(WorkData.Collided.Capsules, Compiled->Capsules);
+	AnimPhysColliders::AddDefinitions(WorkData.Collided.Planars, Compiled->Planars);
+	WorkData.Collided.Compiled.Add(Compiled);
+}
+
 void FAnimNode_AnimPhys::BuildColliders(const USkeletalMeshComponent* RESTRICT MeshComponent)
 {
 	if (MeshComponent == nullptr)
@@ -981,11 +1676,9 @@ void FAnimNode_AnimPhys::BuildColliders(const USkeletalMeshComponent* RESTRICT M
 	WorkData.Collided.Spheres.Empty();
 	WorkData.Collided.Capsules.Empty();
 	WorkData.Collided.Planars.Empty();
+	WorkData.Collided.Compiled.Empty();
 
-	const FReferenceSkeleton& RefSkeleton = MeshComponent->GetSkeletalMeshAsset()->GetRefSkeleton();
-	BuildSphereColliders(RefSkeleton, false, CollisionSettings.SphereColliders);
-	BuildCapsuleColliders(RefSkeleton, false, CollisionSettings.CapsuleColliders);
-	BuildPlanarColliders(RefSkeleton, false, CollisionSettings.PlanarColliders);
+	AddCompiledColliders(MeshComponent->GetSkeletalMeshAsset(), nullptr, false, CollisionSettings.SphereColliders, CollisionSettings.CapsuleColliders, CollisionSettings.PlanarColliders);
 
 	if (CollisionSettings.bCollidedWithAttachedMesh)
 	{
@@ -993,9 +1686,8 @@ void FAnimNode_AnimPhys::BuildColliders(const USkeletalMeshComponent* RESTRICT M
 		UAnimPhysCollisionData* AttachedCollision = (AttachedMeshComponent && AttachedMeshComponent->GetSkeletalMeshAsset()) ? AttachedMeshComponent->GetSkeletalMeshAsset()->GetAssetUserData<UAnimPhysCollisionData>() : nullptr;
 		if (AttachedCollision)
 		{
-			const FReferenceSkeleton& AttachedRefSkeleton = AttachedMeshComponent->GetSkeletalMeshAsset()->GetRefSkeleton();
-			BuildSphereColliders(AttachedRefSkeleton, true, AttachedCollision->GetSphereColliders());
-			BuildCapsuleColliders(AttachedRefSkeleton, true, AttachedCollision->GetCapsuleColliders());
+			const TArray<FAnimPhysPlanarCollider> NoPlanarColliders;
+			AddCompiledColliders(AttachedMeshComponent->GetSkeletalMeshAsset(), AttachedCollision, true, AttachedCollision->GetSphereColliders(), AttachedCollision->GetCapsuleColliders(), NoPlanarColliders);
 		}
 	}
 
@@ -1013,7 +1705,7 @@ void FAnimNode_AnimPhys::ComputeSphereColliderTransform(TArray<FAnimPhys_Collide
 {
 	for (auto& CollidedSphere : CollidedSpheres)
 	{
-		if (CollidedSphere.LimitDistanceSquared <= 0.0f)
+		if (CollidedSphere.Definition->LimitDistanceSquared <= 0.0f)
 		{
 			continue;
 		}
@@ -1037,12 +1729,12 @@ void FAnimNode_AnimPhys::ComputeCapsuleColliderTransform(TArray<FAnimPhys_Collid
 {
 	for (auto& CollidedCapsule : CollidedCapsules)
 	{
-		if (CollidedCapsule.LimitDistanceSquared <= 0.0f)
+		if (CollidedCapsule.Definition->LimitDistanceSquared <= 0.0f)
 		{
 			continue;
 		}
 
-		if (CollidedCapsule.HalfHeight <= 0.0f)
+		if (CollidedCapsule.Definition->HalfHeight <= 0.0f)
 		{
 			continue;
 		}
@@ -1054,8 +1746,8 @@ void FAnimNode_AnimPhys::ComputeCapsuleColliderTransform(TArray<FAnimPhys_Collid
 		}
 
 		CollidedCapsule.bValid = true;
-		CollidedCapsule.SegmentStart = CapsuleTransform.GetLocation() + CapsuleTransform.GetRotation().GetAxisZ() * CollidedCapsule.HalfHeight;
-		CollidedCapsule.SegmentEnd = CapsuleTransform.GetLocation() + CapsuleTransform.GetRotation().GetAxisZ() * (-CollidedCapsule.HalfHeight);
+		CollidedCapsule.SegmentStart = CapsuleTransform.GetLocation() + CapsuleTransform.GetRotation().GetAxisZ() * CollidedCapsule.Definition->HalfHeight;
+		CollidedCapsule.SegmentEnd = CapsuleTransform.GetLocation() + CapsuleTransform.GetRotation().GetAxisZ() * (-CollidedCapsule.Definition->HalfHeight);
 
 #if WITH_EDITORONLY_DATA
 		CollidedCapsule.DebugTransform = CapsuleTransform;
@@ -1065,28 +1757,59 @@ void FAnimNode_AnimPhys::ComputeCapsuleColliderTransform(TArray<FAnimPhys_Collid
 
 void FAnimNode_AnimPhys::ComputeColliderTransform(FPoseContext& RESTRICT Output)
 {
-	ComputeSphereColliderTransform(WorkData.Collided.Spheres);
-	ComputeCapsuleColliderTransform(WorkData.Collided.Capsules);
+	// Dropped by the budget
+	if (NodeData.Degradation >= EAnimPhysDegradation::NoCollision)
+	{
+		WorkData.Collided.Packed.Reset();
+		WorkData.Collided.ChainPacked.Reset();
+		WorkData.Collided.Floor.bValid = false;
+		WorkData.Collided.bSweptCollision = false;
+
+		// Dropping the colliders wakes the sleeping chains like any other collider change, the hash of no colliders is 0
+		WorkData.Collided.Packed.bChangedSinceLastStep |= (WorkData.Collided.Packed.Hash != 0);
+		WorkData.Collided.Packed.Hash = 0;
+		return;
+	}
+
+	const uint32 ColliderTypes = GetColliderTypes();
 
-	for (auto& CollidedPlanar : WorkData.Collided.Planars)
+	if (ColliderTypes & AnimPhysColliderTypes::Sphere)
 	{
-		if (CollidedPlanar.LimitDistanceSquared <= 0.0f)
-		{
-			continue;
-		}
+		ComputeSphereColliderTransform(WorkData.Collided.Spheres);
+	}
+
+	if (ColliderTypes & AnimPhysColliderTypes::Capsule)
+	{
+		ComputeCapsuleColliderTransform(WorkData.Collided.Capsules);
+	}
 
-		FTransform PlanarTransform = FTransform::Identity;
-		if (TryGetCollisionComponentSpaceTransform(PlanarTransform, CollidedPlanar) == false)
+	if (ColliderTypes & AnimPhysColliderTypes::Planar)
+	{
+		for (auto& CollidedPlanar : WorkData.Collided.Planars)
 		{
-			continue;
-		}
+			if (CollidedPlanar.Definition->LimitDistanceSquared <= 0.0f)
+			{
+				continue;
+			}
+
+			FTransform PlanarTransform = FTransform::Identity;
+			if (TryGetCollisionComponentSpaceTransform(PlanarTransform, CollidedPlanar) == false)
+			{
+				continue;
+			}
 
-		CollidedPlanar.bValid = true;
-		CollidedPlanar.Plane = FPlane(PlanarTransform.GetLocation(), PlanarTransform.GetRotation().GetUpVector());
+			CollidedPlanar.bValid = true;
+			CollidedPlanar.Plane = FPlane(PlanarTransform.GetLocation(), PlanarTransform.GetRotation().GetUpVector());
 
 #if WITH_EDITORONLY_DATA
-		CollidedPlanar.DebugTransform = PlanarTransform;
+			CollidedPlanar.DebugTransform = PlanarTransform;
 #endif
+		}
+	}
+
+	if ((ColliderTypes & AnimPhysColliderTypes::Floor) == 0)
+	{
+		WorkData.Collided.Floor.bValid = false;
 	}
 
 	if (WorkData.Collided.Floor.bValid)
@@ -1094,29 +1817,46 @@ void FAnimNode_AnimPhys::ComputeColliderTransform(FPoseContext& RESTRICT Output)
 		WorkData.Collided.Floor.Plane = FPlane(WorkData.Moved.WorldToComponent.TransformPosition(WorkData.Collided.Floor.ImpactPoint), WorkData.Moved.WorldToComponent.TransformVector(WorkData.Collided.Floor.ImpactNormal).GetSafeNormal());
 	}
 
-	if (CollisionSettings.bCollidedWithSimulatedPhysBody)
+	if (ColliderTypes & AnimPhysColliderTypes::PhysBody)
 	{
 		ComputeSphereColliderTransform(WorkData.Collided.PhysBodySpheres);
 		ComputeCapsuleColliderTransform(WorkData.Collided.PhysBodyCapsules);
 	}
+
+	WorkData.Collided.bSweptCollision = CollisionSettings.bUseSweptCollision;
+
+	uint32 PackedColliderTypes = ColliderTypes;
+	if (CollisionSettings.bApplyPhysBodyCollision == false)
+	{
+		PackedColliderTypes &= ~static_cast<uint32>(AnimPhysColliderTypes::PhysBody);
+	}
+
+	WorkData.PackColliders(PackedColliderTypes);
 }
 
 void FAnimNode_AnimPhys::CopyBoneTransformsFromPose(const FCompactPose& RESTRICT Pose)
 {
 	const FBoneContainer& RequiredBones = Pose.GetBoneContainer();
 
+	if (WorkData.Cached.SlotTable.IsValid() == false)
+	{
+		return;
+	}
+
 	FCSPose<FCompactPose> CSPose;
 	CSPose.InitPose(Pose);
 
-	for (auto& CachedComponentSpaceTM : WorkData.Cached.ComponentSpaceTMs)
+	const FAnimPhys_CompiledCacheSlots& SlotTable = *WorkData.Cached.SlotTable;
+	const int32 NumSlots = WorkData.Cached.ComponentSpaceTMs.Num();
+	for (int32 Slot = 0; Slot < NumSlots; ++Slot)
 	{
-		FCompactPoseBoneIndex CompactPoseBoneIndex = RequiredBones.MakeCompactPoseIndex(FMeshPoseBoneIndex(CachedComponentSpaceTM.Key));
+		FCompactPoseBoneIndex CompactPoseBoneIndex = RequiredBones.MakeCompactPoseIndex(SlotTable.BoneIndexes[Slot]);
 		if (CompactPoseBoneIndex.IsValid() == false)
 		{
 			continue;
 		}
 
-		CachedComponentSpaceTM.Value = CSPose.GetComponentSpaceTransform(CompactPoseBoneIndex) * NodeData.LastRootComponentTransform;
+		WorkData.Cached.ComponentSpaceTMs[Slot] = CSPose.GetComponentSpaceTransform(CompactPoseBoneIndex) * NodeData.LastRootComponentTransform;
 	}
 }
 
@@ -1170,9 +1910,58 @@ bool FAnimNode_AnimPhys::IsAllPhysBodiesSimulated(const USkeletalMeshComponent*
 	return true;
 }
 
+int32 FAnimNode_AnimPhys::ComputePhysBodyGeneration(const USkeletalMeshComponent* RESTRICT MeshComponent) const
+{
+	const IAnimPhysMeshComponentInterface* MeshComponentInterface = Cast<IAnimPhysMeshComponentInterface>(MeshComponent);
+	const int32 ReportedGeneration = MeshComponentInterface ? MeshComponentInterface->GetPhysBodySimulationGeneration() : INDEX_NONE;
+	if (ReportedGeneration != INDEX_NONE)
+	{
+		return ReportedGeneration;
+	}
+
+	const int32 RecheckFrames = CVarAnimPhysPhysBodyRecheckFrames.GetValueOnAnyThread();
+	if (MeshComponent == nullptr || RecheckFrames <= 0)
+	{
+		return INDEX_NONE;
+	}
+
+	// Ragdolls switch the component or its root body, the bodies set one by one are caught by the periodic check
+	const FBodyInstance* RootBody = MeshComponent->GetBodyInstance();
+	uint32 Generation = GetTypeHash(MeshComponent->IsPhysicsStateCreated());
+	Generation = HashCombine(Generation, GetTypeHash(MeshComponent->BodyInstance.bSimulatePhysics));
+	Generation = HashCombine(Generation, GetTypeHash(RootBody ? RootBody->bSimulatePhysics : false));
+	Generation = HashCombine(Generation, GetTypeHash(MeshComponent->bBlendPhysics));
+
+	// Phased by the component, so the periodic check of many meshes is spread over the frames instead of falling on the same one
+	const uint64 RecheckPhase = PointerHash(MeshComponent) % static_cast<uint32>(RecheckFrames);
+	Generation = HashCombine(Generation, GetTypeHash((GFrameCounter + RecheckPhase) / static_cast<uint64>(RecheckFrames)));
+
+	return static_cast<int32>(Generation & MAX_int32);
+}
+
+bool FAnimNode_AnimPhys::IsPhysBodyStateUnchanged(const USkeletalMeshComponent* RESTRICT MeshComponent)
+{
+	const int32 Generation = ComputePhysBodyGeneration(MeshComponent);
+	const int32 NumBodies = MeshComponent ? MeshComponent->Bodies.Num() : INDEX_NONE;
+
+	// Bodies are created and destroyed with the physics state, which changes their count
+	const bool bUnchanged = (Generation != INDEX_NONE && Generation == NodeData.PhysBodyGeneration && NumBodies == NodeData.NumPhysBodies && MeshComponent == NodeData.PhysBodyComponent);
+
+	NodeData.PhysBodyGeneration = Generation;
+	NodeData.NumPhysBodies = NumBodies;
+	NodeData.PhysBodyComponent = MeshComponent;
+
+	return bUnchanged;
+}
+
 void FAnimNode_AnimPhys::ComputePhysBody(const USkeletalMeshComponent* RESTRICT MeshComponent)
 {
-	const bool bIsAllPhysBodiesSimulated = IsAllPhysBodiesSimulated(MeshComponent);
+	if (IsPhysBodyStateUnchanged(MeshComponent) == false)
+	{
+		NodeData.bAllPhysBodiesSimulated = IsAllPhysBodiesSimulated(MeshComponent);
+	}
+
+	const bool bIsAllPhysBodiesSimulated = NodeData.bAllPhysBodiesSimulated;
 
 	const bool ShouldBuildPhysBodyColliders = (NodeData.bPhysBodyWasSimulated == false && bIsAllPhysBodiesSimulated);
 	if (ShouldBuildPhysBodyColliders)
@@ -1198,7 +1987,7 @@ void FAnimNode_AnimPhys::ComputePhysBody(const USkeletalMeshComponent* RESTRICT
 
 void FAnimNode_AnimPhys::ComputeFloor(const USkeletalMeshComponent* RESTRICT MeshComponent)
 {
-	if (CollisionSettings.bCollidedWithFloor == false)
+	if (CollisionSettings.bCollidedWithFloor == false || (GetColliderTypes() & AnimPhysColliderTypes::Floor) == 0)
 	{
 		return;
 	}
@@ -1243,7 +2032,7 @@ void FAnimNode_AnimPhys::ComputeFloor(const USkeletalMeshComponent* RESTRICT Mes
 	}
 }
 
-void FAnimNode_AnimPhys::BuildPhysBodyCollidersFromPhysicsAsset(const FReferenceSkeleton& RefSkeleton, const UPhysicsAsset* PhysicsAsset, const bool bFromAttachedMesh)
+void FAnimNode_AnimPhys::BuildPhysBodyCollidersFromPhysicsAsset(FAnimPhys_CompiledColliders& OutColliders, const FReferenceSkeleton& RefSkeleton, const UPhysicsAsset* PhysicsAsset, const bool bFromAttachedMesh) const
 {
 	const int32 NumBodies = PhysicsAsset ? PhysicsAsset->SkeletalBodySetups.Num() : 0;
 	for (int32 BodyIndex = 0; BodyIndex < NumBodies; ++BodyIndex)
@@ -1262,7 +2051,7 @@ void FAnimNode_AnimPhys::BuildPhysBodyCollidersFromPhysicsAsset(const FReference
 
 		for (const auto& Sphere : SkeletalBodySetup->AggGeom.SphereElems)
 		{
-			FAnimPhys_CollidedSphere_WorkData CollidedSphere;
+			FAnimPhys_ColliderDefinition CollidedSphere;
 			CollidedSphere.MeshPoseBoneIndex = MeshPoseBoneIndex;
 			CollidedSphere.LimitDistance = SetupSettings.Radius + (Sphere.Radius * CollisionSettings.PhysBodyScale);
 			CollidedSphere.LimitDistanceSquared = (CollidedSphere.LimitDistance * CollidedSphere.LimitDistance);
@@ -1274,12 +2063,12 @@ void FAnimNode_AnimPhys::BuildPhysBodyCollidersFromPhysicsAsset(const FReference
 			CollidedSphere.DebugRadius = (CollidedSphere.LimitDistance - SetupSettings.Radius);
 #endif
 
-			WorkData.Collided.PhysBodySpheres.Add(CollidedSphere);
+			OutColliders.Spheres.Add(CollidedSphere);
 		}
 
 		for (const auto& Capsule : SkeletalBodySetup->AggGeom.SphylElems)
 		{
-			FAnimPhys_CollidedCapsule_WorkData CollidedCapsule;
+			FAnimPhys_ColliderDefinition CollidedCapsule;
 			CollidedCapsule.MeshPoseBoneIndex = MeshPoseBoneIndex;
 			CollidedCapsule.LimitDistance = SetupSettings.Radius + (Capsule.Radius * CollisionSettings.PhysBodyScale);
 			CollidedCapsule.LimitDistanceSquared = (CollidedCapsule.LimitDistance * CollidedCapsule.LimitDistance);
@@ -1292,11 +2081,24 @@ void FAnimNode_AnimPhys::BuildPhysBodyCollidersFromPhysicsAsset(const FReference
 			CollidedCapsule.DebugRadius = (CollidedCapsule.LimitDistance - SetupSettings.Radius);
 #endif
 
-			WorkData.Collided.PhysBodyCapsules.Add(CollidedCapsule);
+			OutColliders.Capsules.Add(CollidedCapsule);
 		}
 	}
 }
 
+void FAnimNode_AnimPhys::AddCompiledPhysBodyColliders(const USkeletalMesh* SkeletalMesh, const UPhysicsAsset* PhysicsAsset, const bool bFromAttachedMesh)
+{
+	const FAnimPhys_CompiledCollidersKey Key(SkeletalMesh, PhysicsAsset, SetupSettings.Radius, CollisionSettings.PhysBodyScale, bFromAttachedMesh);
+	const FAnimPhys_CompiledCollidersPtr Compiled = AnimPhysCompiledSetup::FindOrCompileColliders(Key, [&](FAnimPhys_CompiledColliders& OutColliders)
+	{
+		BuildPhysBodyCollidersFromPhysicsAsset(OutColliders, SkeletalMesh->GetRefSkeleton(), PhysicsAsset, bFromAttachedMesh);
+	});
+
+	AnimPhysColliders::AddDefinitions(WorkData.Collided.PhysBodySpheres, Compiled->Spheres);
+	AnimPhysColliders::AddDefinitions(WorkData.Collided.PhysBodyCapsules, Compiled->Capsules);
+	WorkData.Collided.PhysBodyCompiled.Add(Compiled);
+}
+
 void FAnimNode_AnimPhys::BuildPhysBodyColliders(const USkeletalMeshComponent* RESTRICT MeshComponent)
 {
 	if (MeshComponent == nullptr)
@@ -1311,18 +2113,14 @@ void FAnimNode_AnimPhys::BuildPhysBodyColliders(const USkeletalMeshComponent* RE
 
 	WorkData.Collided.PhysBodySpheres.Empty();
 	WorkData.Collided.PhysBodyCapsules.Empty();
+	WorkData.Collided.PhysBodyCompiled.Empty();
 
-	const FReferenceSkeleton& RefSkeleton = MeshComponent->GetSkeletalMeshAsset()->GetRefSkeleton();
-	const UPhysicsAsset* PhysicsAsset = MeshComponent->GetPhysicsAsset();
-	BuildPhysBodyCollidersFromPhysicsAsset(RefSkeleton, PhysicsAsset, false);
+	AddCompiledPhysBodyColliders(MeshComponent->GetSkeletalMeshAsset(), MeshComponent->GetPhysicsAsset(), false);
 
 	USkeletalMeshComponent* AttachedMeshComponent = Cast<USkeletalMeshComponent>(MeshComponent->GetAttachParent());
 	if (CollisionSettings.bCollidedWithAttachedMesh && AttachedMeshComponent && AttachedMeshComponent->GetSkeletalMeshAsset())
 	{
-		const FReferenceSkeleton& AttachedRefSkeleton = AttachedMeshComponent->GetSkeletalMeshAsset()->GetRefSkeleton();
-		const UPhysicsAsset* AttachedPhysicsAsset = AttachedMeshComponent->GetPhysicsAsset();
-
-		BuildPhysBodyCollidersFromPhysicsAsset(AttachedRefSkeleton, AttachedPhysicsAsset, true);
+		AddCompiledPhysBodyColliders(AttachedMeshComponent->GetSkeletalMeshAsset(), AttachedMeshComponent->GetPhysicsAsset(), true);
 	}
 
 	WorkData.Collided.bValidPhysBodyColliders = true;
@@ -1330,8 +2128,21 @@ void FAnimNode_AnimPhys::BuildPhysBodyColliders(const USkeletalMeshComponent* RE
 
 void FAnimNode_AnimPhys::CheckTeleport(FPoseContext& RESTRICT Output)
 {
+	// Back on screen after a long time settles to the pose right away, without suspending the simulation like the reset below
+	if (SimulationSettings.bSkipWhileNotRendered && NodeData.bOffscreen == false && NodeData.LastEvalTimeSeconds > 0.0f && NodeData.bHasEvaluated)
+	{
+		const float NotEvaluatedTime = NodeData.WorldTimeSeconds - (NodeData.LastEvalTimeSeconds + NodeData.AccumulatedDeltaTime);
+		const float OffscreenTime = NodeData.bReturnedOnscreen ? (NodeData.WorldTimeSeconds - NodeData.OffscreenSinceSeconds) : 0.0f;
+		if (FMath::Max(NotEvaluatedTime, OffscreenTime) > SimulationSettings.OffscreenSettleTime)
+		{
+			ConditionalSetTeleportType(ETeleportType::ResetPhysics, NodeData.CurrentTeleportType);
+			NodeData.SkippedDeltaTime = 0.0f;
+		}
+
+		NodeData.bReturnedOnscreen = false;
+	}
 	// @ref : FAnimNode_RigidBody::EvaluateSkeletalControl_AnyThread
-	if (EvaluationResetTime > 0.0f && NodeData.LastEvalTimeSeconds > 0.0f && NodeData.bHasEvaluated)
+	else if (EvaluationResetTime > 0.0f && NodeData.LastEvalTimeSeconds > 0.0f && NodeData.bHasEvaluated)
 	{
 		if (NodeData.WorldTimeSeconds - (NodeData.LastEvalTimeSeconds + NodeData.AccumulatedDeltaTime) > EvaluationResetTime)
 		{
@@ -1411,21 +2222,23 @@ void FAnimNode_AnimPhys::DebugDraw(const USkeletalMeshComponent* RESTRICT MeshCo
 
 	FTransform ToWorld = MeshComponent->GetComponentTransform();
 
-	for (auto& Bone : WorkData.Simulated.SimulatedBones)
+	for (int32 BoneIndex = 0; BoneIndex < WorkData.Simulated.Num(); ++BoneIndex)
 	{
-		const FVector PoseLocation = ToWorld.TransformPosition(Bone.PoseComponentSpaceTM.GetLocation());
+		const auto& Bone = WorkData.Simulated.Topology[BoneIndex];
+
+		const FVector PoseLocation = ToWorld.TransformPosition(WorkData.Simulated.PoseLocations[BoneIndex]);
 		DrawDebugPoint(World, PoseLocation, 5.0f, FColor::White, false, DebugTime);
 
-		const FVector BoneLocation = ToWorld.TransformPosition(Bone.ComponentSpaceTM.GetLocation());
+		const FVector BoneLocation = ToWorld.TransformPosition(WorkData.Simulated.Locations[BoneIndex]);
 		if (SetupSettings.Radius > 0.0f)
 		{
 			const FColor Color = (Bone.NumChildren == 0 && Bone.MeshPoseBoneIndex.IsValid() == false) ? FColor::Red : FColor::Yellow;
 			DrawDebugSphere(World, BoneLocation, SetupSettings.Radius, 16, Color, false, DebugTime);
 		}
 
-		if (WorkData.Simulated.SimulatedBones.IsValidIndex(Bone.ParentIndex))
+		if (WorkData.Simulated.IsValidIndex(Bone.ParentIndex))
 		{
-			const FVector ParentBoneLocation = ToWorld.TransformPosition(WorkData.Simulated.SimulatedBones[Bone.ParentIndex].ComponentSpaceTM.GetLocation());
+			const FVector ParentBoneLocation = ToWorld.TransformPosition(WorkData.Simulated.Locations[Bone.ParentIndex]);
 			DrawDebugLine(World, BoneLocation, ParentBoneLocation, FColor::White, false, DebugTime);
 		}
 	}
@@ -1437,8 +2250,8 @@ void FAnimNode_AnimPhys::DebugDraw(const USkeletalMeshComponent* RESTRICT MeshCo
 			continue;
 		}
 
-		const FColor Color = Sphere.bFromAttachedMesh ? FColor::Cyan : FColor::Blue;
-		const float Radius = (Sphere.LimitDistance - SetupSettings.Radius);
+		const FColor Color = Sphere.Definition->bFromAttachedMesh ? FColor::Cyan : FColor::Blue;
+		const float Radius = (Sphere.Definition->LimitDistance - SetupSettings.Radius);
 		DrawDebugSphere(World, ToWorld.TransformPosition(Sphere.Center), Radius, 16, Color, false, DebugTime);
 	}
 
@@ -1449,8 +2262,8 @@ void FAnimNode_AnimPhys::DebugDraw(const USkeletalMeshComponent* RESTRICT MeshCo
 			continue;
 		}
 
-		const FColor Color = Capsule.bFromAttachedMesh ? FColor::Cyan : FColor::Blue;
-		const float Radius = (Capsule.LimitDistance - SetupSettings.Radius);
+		const FColor Color = Capsule.Definition->bFromAttachedMesh ? FColor::Cyan : FColor::Blue;
+		const float Radius = (Capsule.Definition->LimitDistance - SetupSettings.Radius);
 		DrawDebugCylinder(World, ToWorld.TransformPosition(Capsule.SegmentStart), ToWorld.TransformPosition(Capsule.SegmentEnd), Radius, 16, Color, false, DebugTime);
 	}
 
@@ -1461,8 +2274,8 @@ void FAnimNode_AnimPhys::DebugDraw(const USkeletalMeshComponent* RESTRICT MeshCo
 			continue;
 		}
 
-		const FColor Color = Sphere.bFromAttachedMesh ? FColor::Cyan : FColor::Blue;
-		const float Radius = (Sphere.LimitDistance - SetupSettings.Radius);
+		const FColor Color = Sphere.Definition->bFromAttachedMesh ? FColor::Cyan : FColor::Blue;
+		const float Radius = (Sphere.Definition->LimitDistance - SetupSettings.Radius);
 		DrawDebugSphere(World, ToWorld.TransformPosition(Sphere.Center), Radius, 16, Color, false, DebugTime);
 	}
 
@@ -1473,8 +2286,8 @@ void FAnimNode_AnimPhys::DebugDraw(const USkeletalMeshComponent* RESTRICT MeshCo
 			continue;
 		}
 
-		const FColor Color = Capsule.bFromAttachedMesh ? FColor::Cyan : FColor::Blue;
-		const float Radius = (Capsule.LimitDistance - SetupSettings.Radius);
+		const FColor Color = Capsule.Definition->bFromAttachedMesh ? FColor::Cyan : FColor::Blue;
+		const float Radius = (Capsule.Definition->LimitDistance - SetupSettings.Radius);
 		DrawDebugCylinder(World, ToWorld.TransformPosition(Capsule.SegmentStart), ToWorld.TransformPosition(Capsule.SegmentEnd), Radius, 16, Color, false, DebugTime);
 	}
 }
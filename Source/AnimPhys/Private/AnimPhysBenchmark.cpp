@@ -0,0 +1,199 @@
+// Copyright NEXON Games Co., MIT License
+#include "AnimPhysCompiledSetup.h"
+#include "HAL/IConsoleManager.h"
+
+#if !UE_BUILD_SHIPPING
+
+namespace AnimPhysBenchmark
+{
+	// Bones in compact pose order: a spine, limbs hanging off the spine and simulated chains off the last spine bone
+	struct FSyntheticSkeleton
+	{
+		TArray<int32> ParentIndexes;
+		TArray<int32> RootIndexes;
+		TArray<int32> ExcludedIndexes;
+	};
+
+	static FSyntheticSkeleton MakeSkeleton(const int32 InNumBones, const int32 InNumChains)
+	{
+		FSyntheticSkeleton Skeleton;
+
+		const int32 NumSpineBones = FMath::Clamp(InNumBones / 20, 1, 40);
+		const int32 NumChainBones = FMath::Max(1, (InNumBones - NumSpineBones) / (2 * InNumChains));
+		const int32 LimbLength = 10;
+
+		for (int32 BoneIndex = 0; BoneIndex < NumSpineBones; ++BoneIndex)
+		{
+			Skeleton.ParentIndexes.Add(BoneIndex - 1);
+		}
+
+		const int32 HeadIndex = NumSpineBones - 1;
+		for (int32 ChainIndex = 0; ChainIndex < InNumChains && Skeleton.ParentIndexes.Num() < InNumBones; ++ChainIndex)
+		{
+			Skeleton.RootIndexes.Add(Skeleton.ParentIndexes.Add(HeadIndex));
+			for (int32 Depth = 1; Depth < NumChainBones && Skeleton.ParentIndexes.Num() < InNumBones; ++Depth)
+			{
+				Skeleton.ParentIndexes.Add(Skeleton.ParentIndexes.Num() - 1);
+			}
+		}
+
+		// Exclude the lower half of the first chain
+		if (Skeleton.RootIndexes.Num() > 0 && NumChainBones > 1)
+		{
+			Skeleton.ExcludedIndexes.Add(Skeleton.RootIndexes[0] + NumChainBones / 2);
+		}
+
+		int32 LimbIndex = 0;
+		while (Skeleton.ParentIndexes.Num() < InNumBones)
+		{
+			Skeleton.ParentIndexes.Add((LimbIndex++ % NumSpineBones));
+			for (int32 Depth = 1; Depth < LimbLength && Skeleton.ParentIndexes.Num() < InNumBones; ++Depth)
+			{
+				Skeleton.ParentIndexes.Add(Skeleton.ParentIndexes.Num() - 1);
+			}
+		}
+
+		return Skeleton;
+	}
+
+	static bool IsChildOf(const TArray<int32>& InParentIndexes, const int32 InBoneIndex, const int32 InParentBoneIndex)
+	{
+		for (int32 BoneIndex = InParentIndexes[InBoneIndex]; BoneIndex != INDEX_NONE; BoneIndex = InParentIndexes[BoneIndex])
+		{
+			if (BoneIndex == InParentBoneIndex)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Per simulated bone, in the order they were added
+	struct FBruteForceTopology
+	{
+		TArray<int32> BoneIndexes;
+		TArray<int32> ParentIndexes;
+		TArray<int32> ChainIndexes;
+	};
+
+	// The previous builder, every bone is checked against every excluded and simulated root
+	static void CompileTopologyBruteForce(const FSyntheticSkeleton& InSkeleton, FBruteForceTopology& OutTopology)
+	{
+		OutTopology.BoneIndexes.Reset();
+		OutTopology.ParentIndexes.Reset();
+		OutTopology.ChainIndexes.Reset();
+
+		TMap<int32, int32> SimulatedBoneMap;
+
+		for (const int32 RootIndex : InSkeleton.RootIndexes)
+		{
+			SimulatedBoneMap.Add(RootIndex, OutTopology.BoneIndexes.Add(RootIndex));
+			OutTopology.ParentIndexes.Add(INDEX_NONE);
+			OutTopology.ChainIndexes.Add(OutTopology.ChainIndexes.Num());
+		}
+
+		for (int32 BoneIndex = 0; BoneIndex < InSkeleton.ParentIndexes.Num(); ++BoneIndex)
+		{
+			bool ShouldExclude = false;
+			for (const int32 ExcludedIndex : InSkeleton.ExcludedIndexes)
+			{
+				if (IsChildOf(InSkeleton.ParentIndexes, BoneIndex, ExcludedIndex))
+				{
+					ShouldExclude = true;
+					break;
+				}
+			}
+			if (ShouldExclude)
+			{
+				continue;
+			}
+
+			bool FoundChild = false;
+			for (const int32 RootIndex : InSkeleton.RootIndexes)
+			{
+				if (IsChildOf(InSkeleton.ParentIndexes, BoneIndex, RootIndex))
+				{
+					FoundChild = true;
+					break;
+				}
+			}
+			const int32* ParentIndex = FoundChild ? SimulatedBoneMap.Find(InSkeleton.ParentIndexes[BoneIndex]) : nullptr;
+			if (ParentIndex)
+			{
+				const int32 ChainIndex = OutTopology.ChainIndexes[*ParentIndex];
+				OutTopology.ParentIndexes.Add(*ParentIndex);
+				OutTopology.ChainIndexes.Add(ChainIndex);
+				SimulatedBoneMap.Add(BoneIndex, OutTopology.BoneIndexes.Add(BoneIndex));
+			}
+		}
+	}
+
+	// Index of the first simulated bone the two builders disagree on, INDEX_NONE when they match
+	static int32 FindMismatch(const FBruteForceTopology& InBruteForce, const TArray<FAnimPhys_SimulatedBone_Topology>& InTopology, const TArray<int32>& InBoneIndexes)
+	{
+		const int32 NumBones = FMath::Min(InBruteForce.BoneIndexes.Num(), InTopology.Num());
+		for (int32 Index = 0; Index < NumBones; ++Index)
+		{
+			if (InBruteForce.BoneIndexes[Index] != InBoneIndexes[Index]
+				|| InBruteForce.ParentIndexes[Index] != InTopology[Index].ParentIndex
+				|| InBruteForce.ChainIndexes[Index] != InTopology[Index].ChainIndex)
+			{
+				return Index;
+			}
+		}
+
+		return (InBruteForce.BoneIndexes.Num() != InTopology.Num()) ? NumBones : INDEX_NONE;
+	}
+
+	static void Run(const TArray<FString>& Args, FOutputDevice& Ar)
+	{
+		const int32 NumIterations = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 100;
+		const int32 NumChains = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 40;
+		const int32 NumBonesCases[] = { 250, 500, 1000, 2000 };
+
+		Ar.Logf(TEXT("AnimPhys build benchmark, %d chains, %d iterations"), NumChains, NumIterations);
+
+		for (const int32 NumBones : NumBonesCases)
+		{
+			const FSyntheticSkeleton Skeleton = MakeSkeleton(NumBones, NumChains);
+
+			TArray<FAnimPhys_SimulatedBone_Topology> Topology;
+			TArray<int32> ChainRootIndexes;
+			TArray<int32> BoneIndexes;
+			TArray<FAnimPhys_DecimatedBone_Topology> DecimatedBones;
+			TArray<int32> DecimatedBoneIndexes;
+
+			FBruteForceTopology BruteForceTopology;
+			double StartTime = FPlatformTime::Seconds();
+			for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+			{
+				CompileTopologyBruteForce(Skeleton, BruteForceTopology);
+			}
+			const double BruteForceTime = (FPlatformTime::Seconds() - StartTime) / NumIterations;
+
+			StartTime = FPlatformTime::Seconds();
+			for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+			{
+				FAnimPhys_CompiledSetup::CompileTopology(Skeleton.ParentIndexes, Skeleton.RootIndexes, Skeleton.ExcludedIndexes, false, 0, 1, Topology, ChainRootIndexes, BoneIndexes, DecimatedBones, DecimatedBoneIndexes);
+			}
+			const double SinglePassTime = (FPlatformTime::Seconds() - StartTime) / NumIterations;
+
+			Ar.Logf(TEXT("  %4d bones: %4d simulated, brute force %8.3f us, single pass %8.3f us"),
+				Skeleton.ParentIndexes.Num(), Topology.Num(), BruteForceTime * 1e6, SinglePassTime * 1e6);
+
+			const int32 MismatchIndex = FindMismatch(BruteForceTopology, Topology, BoneIndexes);
+			if (MismatchIndex != INDEX_NONE)
+			{
+				Ar.Logf(TEXT("    MISMATCH at simulated bone %d of %d, brute force has %d"), MismatchIndex, Topology.Num(), BruteForceTopology.BoneIndexes.Num());
+			}
+		}
+	}
+}
+
+static FAutoConsoleCommandWithArgsAndOutputDevice AnimPhysBenchmarkBuildCommand(
+	TEXT("AnimPhys.BenchmarkBuild"),
+	TEXT("Times building the simulated bones of synthetic skeletons. Args: [Iterations] [NumChains]"),
+	FConsoleCommandWithArgsAndOutputDeviceDelegate::CreateStatic(&AnimPhysBenchmark::Run));
+
+#endif
@@ -0,0 +1,390 @@
+// Copyright NEXON Games Co., MIT License
+#include "AnimPhysCompiledSetup.h"
+#include "AnimPhysWorkData.h"
+
+void FAnimPhys_CompiledSetup::Compile(const FBoneContainer& InRequiredBones, const TArray<FBoneReference>& InBonesToSimulate, const TArray<FBoneReference>& InBonesToExculude, const bool bInBuildEndBones, const int32 InMaxSimulatedBones, const int32 InDecimationStep)
+{
+	const int32 NumBones = InRequiredBones.GetCompactPoseNumBones();
+
+	TArray<int32> ParentIndexes;
+	ParentIndexes.SetNumUninitialized(NumBones);
+	for (FCompactPoseBoneIndex BoneIndex(0); BoneIndex.GetInt() < NumBones; ++BoneIndex)
+	{
+		ParentIndexes[BoneIndex.GetInt()] = InRequiredBones.GetParentBoneIndex(BoneIndex).GetInt();
+	}
+
+	auto GetCompactPoseIndexes = [&InRequiredBones](const TArray<FBoneReference>& InBones)
+	{
+		TArray<int32> CompactPoseIndexes;
+		for (const auto& Bone : InBones)
+		{
+			if (Bone.IsValidToEvaluate())
+			{
+				CompactPoseIndexes.Add(Bone.GetCompactPoseIndex(InRequiredBones).GetInt());
+			}
+		}
+		return CompactPoseIndexes;
+	};
+
+	const TArray<int32> RootIndexes = GetCompactPoseIndexes(InBonesToSimulate);
+	const TArray<int32> ExcludedIndexes = GetCompactPoseIndexes(InBonesToExculude);
+
+	TArray<int32> BoneIndexes;
+	TArray<int32> DecimatedBoneIndexes;
+	CompileTopology(ParentIndexes, RootIndexes, ExcludedIndexes, bInBuildEndBones, InMaxSimulatedBones, InDecimationStep, Topology, ChainRootIndexes, BoneIndexes, DecimatedBones, DecimatedBoneIndexes);
+
+	for (int32 SimulatedBoneIndex = 0; SimulatedBoneIndex < Topology.Num(); ++SimulatedBoneIndex)
+	{
+		if (BoneIndexes[SimulatedBoneIndex] == INDEX_NONE)
+		{
+			continue;
+		}
+
+		const FCompactPoseBoneIndex CompactPoseIndex(BoneIndexes[SimulatedBoneIndex]);
+
+		auto& Bone = Topology[SimulatedBoneIndex];
+		Bone.MeshPoseBoneIndex = InRequiredBones.MakeMeshPoseIndex(CompactPoseIndex);
+
+		if (Bone.ParentIndex == INDEX_NONE)
+		{
+			Bone.ParentMeshPoseBoneIndex = InRequiredBones.MakeMeshPoseIndex(InRequiredBones.GetParentBoneIndex(CompactPoseIndex));
+		}
+	}
+
+	for (int32 DecimatedIndex = 0; DecimatedIndex < DecimatedBones.Num(); ++DecimatedIndex)
+	{
+		DecimatedBones[DecimatedIndex].MeshPoseBoneIndex = InRequiredBones.MakeMeshPoseIndex(FCompactPoseBoneIndex(DecimatedBoneIndexes[DecimatedIndex]));
+	}
+}
+
+void FAnimPhys_CompiledSetup::CompileTopology(TConstArrayView<int32> InParentIndexes, TConstArrayView<int32> InRootIndexes, TConstArrayView<int32> InExcludedIndexes, const bool bInBuildEndBones, const int32 InMaxSimulatedBones, const int32 InDecimationStep,
+	TArray<FAnimPhys_SimulatedBone_Topology>& OutTopology, TArray<int32>& OutChainRootIndexes, TArray<int32>& OutBoneIndexes,
+	TArray<FAnimPhys_DecimatedBone_Topology>& OutDecimatedBones, TArray<int32>& OutDecimatedBoneIndexes)
+{
+	const int32 NumBones = InParentIndexes.Num();
+
+	OutTopology.Reset();
+	OutChainRootIndexes.Reset();
+	OutBoneIndexes.Reset();
+	OutDecimatedBones.Reset();
+	OutDecimatedBoneIndexes.Reset();
+
+	// Compact pose bone to simulated bone
+	TArray<int32> SimulatedBoneMap;
+	SimulatedBoneMap.Init(INDEX_NONE, NumBones);
+
+	// Compact pose bone to decimated bone and the depth below its chain root, only used when decimating
+	const bool bDecimate = (InDecimationStep > 1);
+	TArray<int32> DecimatedBoneMap;
+	TArray<int32> ChainDepths;
+	TArray<int32> NumBoneChildren;
+	if (bDecimate)
+	{
+		DecimatedBoneMap.Init(INDEX_NONE, NumBones);
+		ChainDepths.Init(0, NumBones);
+		NumBoneChildren.Init(0, NumBones);
+
+		for (const int32 ParentBoneIndex : InParentIndexes)
+		{
+			if (NumBoneChildren.IsValidIndex(ParentBoneIndex))
+			{
+				NumBoneChildren[ParentBoneIndex] += 1;
+			}
+		}
+	}
+
+	for (const int32 RootIndex : InRootIndexes)
+	{
+		if (SimulatedBoneMap.IsValidIndex(RootIndex) == false || SimulatedBoneMap[RootIndex] != INDEX_NONE)
+		{
+			continue;
+		}
+
+		// Every chain takes at least its root, so more chains than the cap would go over it
+		if (InMaxSimulatedBones > 0 && OutChainRootIndexes.Num() >= InMaxSimulatedBones)
+		{
+			break;
+		}
+
+		FAnimPhys_SimulatedBone_Topology NewRootBone;
+		NewRootBone.ChainIndex = OutChainRootIndexes.Num();
+
+		const int32 Index = OutTopology.Add(NewRootBone);
+		OutBoneIndexes.Add(RootIndex);
+		OutChainRootIndexes.Add(Index);
+
+		SimulatedBoneMap[RootIndex] = Index;
+	}
+
+	// Set on excluded roots and everything below them, the excluded roots themselves are still simulated
+	TBitArray<> ExcludesChildren(false, NumBones);
+	for (const int32 ExcludedIndex : InExcludedIndexes)
+	{
+		if (ExcludesChildren.IsValidIndex(ExcludedIndex))
+		{
+			ExcludesChildren[ExcludedIndex] = true;
+		}
+	}
+
+	const int32 MaxChainBones = (InMaxSimulatedBones > 0) ? FMath::Max(1, InMaxSimulatedBones / FMath::Max(1, OutChainRootIndexes.Num())) : MAX_int32;
+	TArray<int32> NumChainBones;
+	NumChainBones.Init(1, OutChainRootIndexes.Num());
+
+	for (int32 BoneIndex = 0; BoneIndex < NumBones; ++BoneIndex)
+	{
+		const int32 ParentBoneIndex = InParentIndexes[BoneIndex];
+		if (ParentBoneIndex == INDEX_NONE)
+		{
+			continue;
+		}
+
+		if (ExcludesChildren[ParentBoneIndex])
+		{
+			ExcludesChildren[BoneIndex] = true;
+			continue;
+		}
+
+		const int32 DecimatedParentIndex = bDecimate ? DecimatedBoneMap[ParentBoneIndex] : INDEX_NONE;
+		const int32 ParentIndex = (DecimatedParentIndex != INDEX_NONE) ? OutDecimatedBones[DecimatedParentIndex].SimulatedParentIndex : SimulatedBoneMap[ParentBoneIndex];
+		if (ParentIndex == INDEX_NONE || SimulatedBoneMap[BoneIndex] != INDEX_NONE)
+		{
+			continue;
+		}
+
+		// Only every InDecimationStep-th bone down the chain is simulated, the ones in between follow it.
+		// Tips, branching bones and excluded roots are kept, so every decimated bone lies on a segment between two simulated bones
+		if (bDecimate)
+		{
+			ChainDepths[BoneIndex] = ChainDepths[ParentBoneIndex] + 1;
+
+			const bool bCanDecimate = (NumBoneChildren[BoneIndex] == 1 && ExcludesChildren[BoneIndex] == false);
+			if (bCanDecimate && ChainDepths[BoneIndex] % InDecimationStep != 0)
+			{
+				// Nothing below would be simulated
+				if (NumChainBones[OutTopology[ParentIndex].ChainIndex] >= MaxChainBones)
+				{
+					ExcludesChildren[BoneIndex] = true;
+					continue;
+				}
+
+				FAnimPhys_DecimatedBone_Topology NewDecimatedBone;
+				NewDecimatedBone.SimulatedParentIndex = ParentIndex;
+				NewDecimatedBone.DecimatedParentIndex = DecimatedParentIndex;
+
+				DecimatedBoneMap[BoneIndex] = OutDecimatedBones.Add(NewDecimatedBone);
+				OutDecimatedBoneIndexes.Add(BoneIndex);
+				continue;
+			}
+		}
+
+		// The chain used up its share, the rest of the branch is left out
+		if (NumChainBones[OutTopology[ParentIndex].ChainIndex]++ >= MaxChainBones)
+		{
+			ExcludesChildren[BoneIndex] = true;
+			continue;
+		}
+
+		FAnimPhys_SimulatedBone_Topology NewChildBone;
+		NewChildBone.ParentIndex = ParentIndex;
+		NewChildBone.ChainIndex = OutTopology[ParentIndex].ChainIndex;
+		NewChildBone.DecimatedParentIndex = DecimatedParentIndex;
+
+		const int32 SimulatedBoneIndex = OutTopology.Add(NewChildBone);
+		OutBoneIndexes.Add(BoneIndex);
+		SimulatedBoneMap[BoneIndex] = SimulatedBoneIndex;
+
+		OutTopology[ParentIndex].NumChildren += 1;
+		OutTopology[ParentIndex].LastChildIndex = SimulatedBoneIndex;
+
+		// Decimated bones only have one child each, so the segment up to the simulated parent ends here
+		if (DecimatedParentIndex != INDEX_NONE)
+		{
+			const int32 ParentDepth = ChainDepths[OutBoneIndexes[ParentIndex]];
+			const float SegmentDepth = static_cast<float>(ChainDepths[BoneIndex] - ParentDepth);
+
+			for (int32 DecimatedIndex = DecimatedParentIndex; DecimatedIndex != INDEX_NONE; DecimatedIndex = OutDecimatedBones[DecimatedIndex].DecimatedParentIndex)
+			{
+				OutDecimatedBones[DecimatedIndex].SimulatedChildIndex = SimulatedBoneIndex;
+				OutDecimatedBones[DecimatedIndex].SegmentAlpha = (ChainDepths[OutDecimatedBoneIndexes[DecimatedIndex]] - ParentDepth) / SegmentDepth;
+			}
+		}
+	}
+
+	const bool ShouldBuildEndBone = (bInBuildEndBones && InExcludedIndexes.IsEmpty());
+	if (ShouldBuildEndBone)
+	{
+		const int32 NumSimulatedBones = OutTopology.Num();
+		for (int32 EndBoneParentIndex = 0; EndBoneParentIndex < NumSimulatedBones; ++EndBoneParentIndex)
+		{
+			if (OutTopology[EndBoneParentIndex].NumChildren != 0)
+			{
+				continue;
+			}
+
+			if (InMaxSimulatedBones > 0 && OutTopology.Num() >= InMaxSimulatedBones)
+			{
+				break;
+			}
+
+			FAnimPhys_SimulatedBone_Topology NewEndBone;
+			NewEndBone.ParentIndex = EndBoneParentIndex;
+			NewEndBone.ChainIndex = OutTopology[EndBoneParentIndex].ChainIndex;
+
+			const int32 SimulatedBoneIndex = OutTopology.Add(NewEndBone);
+			OutBoneIndexes.Add(INDEX_NONE);
+
+			OutTopology[EndBoneParentIndex].NumChildren += 1;
+			OutTopology[EndBoneParentIndex].LastChildIndex = SimulatedBoneIndex;
+		}
+	}
+}
+
+FAnimPhys_CompiledSetupKey::FAnimPhys_CompiledSetupKey(const FBoneContainer& InRequiredBones, const TArray<FBoneReference>& InBonesToSimulate, const TArray<FBoneReference>& InBonesToExculude, const bool bInBuildEndBones, const int32 InMaxSimulatedBones, const int32 InDecimationStep)
+	: Asset(InRequiredBones.GetAsset())
+	, RequiredBoneIndices(InRequiredBones.GetBoneIndicesArray())
+	, bBuildEndBones(bInBuildEndBones)
+	, MaxSimulatedBones(InMaxSimulatedBones)
+	, DecimationStep(InDecimationStep)
+{
+	Hash = GetTypeHash(Asset);
+	Hash = HashCombine(Hash, GetTypeHash(bBuildEndBones));
+	Hash = HashCombine(Hash, GetTypeHash(MaxSimulatedBones));
+	Hash = HashCombine(Hash, GetTypeHash(DecimationStep));
+	Hash = HashCombine(Hash, FCrc::MemCrc32(RequiredBoneIndices.GetData(), RequiredBoneIndices.Num() * sizeof(FBoneIndexType)));
+
+	for (const auto& Bone : InBonesToSimulate)
+	{
+		BonesToSimulate.Add(Bone.BoneName);
+		Hash = HashCombine(Hash, GetTypeHash(Bone.BoneName));
+	}
+
+	for (const auto& Bone : InBonesToExculude)
+	{
+		BonesToExculude.Add(Bone.BoneName);
+		Hash = HashCombine(Hash, GetTypeHash(Bone.BoneName));
+	}
+}
+
+bool FAnimPhys_CompiledSetupKey::operator==(const FAnimPhys_CompiledSetupKey& Other) const
+{
+	return Asset == Other.Asset
+		&& bBuildEndBones == Other.bBuildEndBones
+		&& MaxSimulatedBones == Other.MaxSimulatedBones
+		&& DecimationStep == Other.DecimationStep
+		&& RequiredBoneIndices == Other.RequiredBoneIndices
+		&& BonesToSimulate == Other.BonesToSimulate
+		&& BonesToExculude == Other.BonesToExculude;
+}
+
+void FAnimPhys_CompiledCacheSlots::Compile(const TArray<int32>& InBoneIndexes, const int32 InNumBones)
+{
+	Slots.Init(INDEX_NONE, InNumBones);
+	BoneIndexes.Reset(InBoneIndexes.Num());
+
+	for (const int32 BoneIndex : InBoneIndexes)
+	{
+		if (Slots.IsValidIndex(BoneIndex))
+		{
+			Slots[BoneIndex] = BoneIndexes.Add(FMeshPoseBoneIndex(BoneIndex));
+		}
+	}
+}
+
+FAnimPhys_CompiledCacheSlotsKey::FAnimPhys_CompiledCacheSlotsKey(const TArray<int32>& InSortedBoneIndexes, const int32 InNumBones)
+	: BoneIndexes(InSortedBoneIndexes)
+	, NumBones(InNumBones)
+{
+	Hash = HashCombine(GetTypeHash(NumBones), FCrc::MemCrc32(BoneIndexes.GetData(), BoneIndexes.Num() * sizeof(int32)));
+}
+
+FAnimPhys_CompiledCollidersKey::FAnimPhys_CompiledCollidersKey(const UObject* InMesh, const UObject* InSource, const float InRadius, const float InPhysBodyScale, const bool bInFromAttachedMesh)
+	: Mesh(InMesh)
+	, Source(InSource)
+	, Radius(InRadius)
+	, PhysBodyScale(InPhysBodyScale)
+	, bFromAttachedMesh(bInFromAttachedMesh)
+{
+	Hash = HashCombine(GetTypeHash(Mesh), GetTypeHash(Source));
+	Hash = HashCombine(Hash, GetTypeHash(Radius));
+	Hash = HashCombine(Hash, GetTypeHash(PhysBodyScale));
+	Hash = HashCombine(Hash, GetTypeHash(bFromAttachedMesh));
+}
+
+void FAnimPhys_CompiledCollidersKey::AddColliders(TConstArrayView<FAnimPhysSphereCollider> InSpheres, TConstArrayView<FAnimPhysCapsuleCollider> InCapsules, TConstArrayView<FAnimPhysPlanarCollider> InPlanars)
+{
+	// The counts keep colliders of different types apart
+	Shapes.Add(static_cast<float>(InSpheres.Num()));
+	Shapes.Add(static_cast<float>(InCapsules.Num()));
+	Shapes.Add(static_cast<float>(InPlanars.Num()));
+
+	for (const auto& Sphere : InSpheres)
+	{
+		AddCollider(Sphere, Sphere.Radius, 0.0f);
+	}
+
+	for (const auto& Capsule : InCapsules)
+	{
+		AddCollider(Capsule, Capsule.Radius, Capsule.Length);
+	}
+
+	for (const auto& Planar : InPlanars)
+	{
+		AddCollider(Planar, 0.0f, 0.0f);
+	}
+
+	Hash = HashCombine(Hash, FCrc::MemCrc32(Shapes.GetData(), Shapes.Num() * sizeof(float)));
+}
+
+void FAnimPhys_CompiledCollidersKey::AddCollider(const FAnimPhysColliderBase& InCollider, const float InRadius, const float InLength)
+{
+	BoneNames.Add(InCollider.DrivingBone.BoneName);
+	Hash = HashCombine(Hash, GetTypeHash(InCollider.DrivingBone.BoneName));
+
+	Shapes.Append({ InRadius, InLength,
+		static_cast<float>(InCollider.OffsetLocation.X), static_cast<float>(InCollider.OffsetLocation.Y), static_cast<float>(InCollider.OffsetLocation.Z),
+		static_cast<float>(InCollider.OffsetRotation.Pitch), static_cast<float>(InCollider.OffsetRotation.Yaw), static_cast<float>(InCollider.OffsetRotation.Roll) });
+}
+
+bool FAnimPhys_CompiledCollidersKey::operator==(const FAnimPhys_CompiledCollidersKey& Other) const
+{
+	return Mesh == Other.Mesh
+		&& Source == Other.Source
+		&& Radius == Other.Radius
+		&& PhysBodyScale == Other.PhysBodyScale
+		&& bFromAttachedMesh == Other.bFromAttachedMesh
+		&& BoneNames == Other.BoneNames
+		&& Shapes == Other.Shapes;
+}
+
+namespace AnimPhysCompiledSetup
+{
+	static TAnimPhysCompiledRegistry<FAnimPhys_CompiledSetupKey, FAnimPhys_CompiledSetup> SetupRegistry;
+	static TAnimPhysCompiledRegistry<FAnimPhys_CompiledCacheSlotsKey, FAnimPhys_CompiledCacheSlots> CacheSlotsRegistry;
+	static TAnimPhysCompiledRegistry<FAnimPhys_CompiledCollidersKey, FAnimPhys_CompiledColliders> CollidersRegistry;
+
+	FAnimPhys_CompiledSetupPtr FindOrCompile(const FBoneContainer& InRequiredBones, const TArray<FBoneReference>& InBonesToSimulate, const TArray<FBoneReference>& InBonesToExculude, const bool bInBuildEndBones, const int32 InMaxSimulatedBones, const int32 InDecimationStep)
+	{
+		const FAnimPhys_CompiledSetupKey Key(InRequiredBones, InBonesToSimulate, InBonesToExculude, bInBuildEndBones, InMaxSimulatedBones, InDecimationStep);
+		return SetupRegistry.FindOrCompile(Key, [&](FAnimPhys_CompiledSetup& OutSetup)
+		{
+			OutSetup.Compile(InRequiredBones, InBonesToSimulate, InBonesToExculude, bInBuildEndBones, InMaxSimulatedBones, InDecimationStep);
+		});
+	}
+
+	FAnimPhys_CompiledCacheSlotsPtr FindOrCompileCacheSlots(const TArray<int32>& InBoneIndexes, const int32 InNumBones)
+	{
+		TArray<int32> SortedBoneIndexes = InBoneIndexes;
+		SortedBoneIndexes.Sort();
+
+		const FAnimPhys_CompiledCacheSlotsKey Key(SortedBoneIndexes, InNumBones);
+		return CacheSlotsRegistry.FindOrCompile(Key, [&](FAnimPhys_CompiledCacheSlots& OutSlots)
+		{
+			OutSlots.Compile(SortedBoneIndexes, InNumBones);
+		});
+	}
+
+	FAnimPhys_CompiledCollidersPtr FindOrCompileColliders(const FAnimPhys_CompiledCollidersKey& InKey, TFunctionRef<void(FAnimPhys_CompiledColliders&)> InCompile)
+	{
+		return CollidersRegistry.FindOrCompile(InKey, InCompile);
+	}
+}
@@ -0,0 +1,486 @@
+// Copyright NEXON Games Co., MIT License
+#include "AnimPhysLaneBatch.h"
+
+namespace AnimPhysLanes
+{
+	struct FVec
+	{
+		VectorRegister4Float X;
+		VectorRegister4Float Y;
+		VectorRegister4Float Z;
+	};
+
+	static FORCEINLINE FVec Load(const FAnimPhys_LaneVector& InVector)
+	{
+		return { VectorLoadAligned(InVector.X), VectorLoadAligned(InVector.Y), VectorLoadAligned(InVector.Z) };
+	}
+
+	static FORCEINLINE void Store(const FVec& InVector, FAnimPhys_LaneVector& OutVector)
+	{
+		VectorStoreAligned(InVector.X, OutVector.X);
+		VectorStoreAligned(InVector.Y, OutVector.Y);
+		VectorStoreAligned(InVector.Z, OutVector.Z);
+	}
+
+	static FORCEINLINE FVec Add(const FVec& A, const FVec& B)
+	{
+		return { VectorAdd(A.X, B.X), VectorAdd(A.Y, B.Y), VectorAdd(A.Z, B.Z) };
+	}
+
+	static FORCEINLINE FVec Sub(const FVec& A, const FVec& B)
+	{
+		return { VectorSubtract(A.X, B.X), VectorSubtract(A.Y, B.Y), VectorSubtract(A.Z, B.Z) };
+	}
+
+	static FORCEINLINE FVec Mul(const FVec& A, const FVec& B)
+	{
+		return { VectorMultiply(A.X, B.X), VectorMultiply(A.Y, B.Y), VectorMultiply(A.Z, B.Z) };
+	}
+
+	static FORCEINLINE FVec Scale(const FVec& A, const VectorRegister4Float& S)
+	{
+		return { VectorMultiply(A.X, S), VectorMultiply(A.Y, S), VectorMultiply(A.Z, S) };
+	}
+
+	// A * S + B
+	static FORCEINLINE FVec ScaleAdd(const FVec& A, const VectorRegister4Float& S, const FVec& B)
+	{
+		return { VectorMultiplyAdd(A.X, S, B.X), VectorMultiplyAdd(A.Y, S, B.Y), VectorMultiplyAdd(A.Z, S, B.Z) };
+	}
+
+	static FORCEINLINE VectorRegister4Float Dot(const FVec& A, const FVec& B)
+	{
+		return VectorMultiplyAdd(A.Z, B.Z, VectorMultiplyAdd(A.Y, B.Y, VectorMultiply(A.X, B.X)));
+	}
+
+	static FORCEINLINE FVec Cross(const FVec& A, const FVec& B)
+	{
+		return {
+			VectorNegateMultiplyAdd(A.Z, B.Y, VectorMultiply(A.Y, B.Z)),
+			VectorNegateMultiplyAdd(A.X, B.Z, VectorMultiply(A.Z, B.X)),
+			VectorNegateMultiplyAdd(A.Y, B.X, VectorMultiply(A.X, B.Y)) };
+	}
+
+	static FORCEINLINE FVec Select(const VectorRegister4Float& InMask, const FVec& A, const FVec& B)
+	{
+		return { VectorSelect(InMask, A.X, B.X), VectorSelect(InMask, A.Y, B.Y), VectorSelect(InMask, A.Z, B.Z) };
+	}
+
+	// Zero where the vector is too small to normalize, like FVector::GetSafeNormal
+	static FORCEINLINE FVec SafeNormal(const FVec& A)
+	{
+		const VectorRegister4Float SizeSquared = Dot(A, A);
+		const VectorRegister4Float Valid = VectorCompareGT(SizeSquared, VectorSetFloat1(UE_SMALL_NUMBER));
+		const VectorRegister4Float InvSize = VectorDivide(VectorOneFloat(), VectorSqrt(VectorMax(SizeSquared, VectorSetFloat1(UE_SMALL_NUMBER))));
+		return Select(Valid, Scale(A, InvSize), FVec{ VectorZeroFloat(), VectorZeroFloat(), VectorZeroFloat() });
+	}
+
+	static FORCEINLINE VectorRegister4Float MakeMask(const uint32 InLanes)
+	{
+		return VectorCompareGT(MakeVectorRegisterFloat((InLanes & 1) ? 1.0f : 0.0f, (InLanes & 2) ? 1.0f : 0.0f, (InLanes & 4) ? 1.0f : 0.0f, (InLanes & 8) ? 1.0f : 0.0f), VectorZeroFloat());
+	}
+
+	static FORCEINLINE FVector GetLane(const FAnimPhys_LaneVector& InVector, const int32 InLane)
+	{
+		return FVector(InVector.X[InLane], InVector.Y[InLane], InVector.Z[InLane]);
+	}
+
+	static FORCEINLINE void SetLane(FAnimPhys_LaneVector& OutVector, const int32 InLane, const FVector& InValue)
+	{
+		OutVector.X[InLane] = InValue.X;
+		OutVector.Y[InLane] = InValue.Y;
+		OutVector.Z[InLane] = InValue.Z;
+	}
+
+	// One value per lane, zero for lanes without params
+	template <typename GetterType>
+	static FORCEINLINE VectorRegister4Float LoadParam(TConstArrayView<const FAnimPhys_SolverParams*> InParams, GetterType&& InGetter)
+	{
+		FAnimPhys_LaneScalar Lanes = {};
+		for (int32 Lane = 0; Lane < InParams.Num(); ++Lane)
+		{
+			if (InParams[Lane])
+			{
+				Lanes.V[Lane] = InGetter(*InParams[Lane], Lane);
+			}
+		}
+
+		return VectorLoadAligned(Lanes.V);
+	}
+
+	template <typename GetterType>
+	static FORCEINLINE FVec LoadParamVector(TConstArrayView<const FAnimPhys_SolverParams*> InParams, GetterType&& InGetter)
+	{
+		FAnimPhys_LaneVector Lanes = {};
+		for (int32 Lane = 0; Lane < InParams.Num(); ++Lane)
+		{
+			if (InParams[Lane])
+			{
+				SetLane(Lanes, Lane, InGetter(*InParams[Lane], Lane));
+			}
+		}
+
+		return Load(Lanes);
+	}
+}
+
+using FLaneKernel = void (FAnimPhys_LaneBatch::*)(TConstArrayView<const FAnimPhys_SolverParams*>, const uint32);
+
+template <uint32... InFeatures>
+static const FLaneKernel* GetLaneKernels(TIntegerSequence<uint32, InFeatures...>)
+{
+	static const FLaneKernel Kernels[] = { &FAnimPhys_LaneBatch::SimulateBonesKernel<InFeatures>... };
+	return Kernels;
+}
+
+bool FAnimPhys_LaneBatch::CanShareLanes(const FAnimPhys_WorkData& InA, const FAnimPhys_WorkData& InB)
+{
+	return InA.Simulated.Setup.IsValid() && InA.Simulated.Setup == InB.Simulated.Setup;
+}
+
+void FAnimPhys_LaneBatch::SimulateBones(TConstArrayView<const FAnimPhys_SolverParams*> InParams)
+{
+	check(InParams.Num() == Lanes.Num() && Lanes.Num() <= NumLanes);
+
+	uint32 ActiveLanes = 0;
+	int32 NumActiveLanes = 0;
+	int32 FirstLane = INDEX_NONE;
+	bool bSameFeatures = true;
+
+	for (int32 Lane = 0; Lane < Lanes.Num(); ++Lane)
+	{
+		if (InParams[Lane] == nullptr)
+		{
+			continue;
+		}
+
+		if (FirstLane == INDEX_NONE)
+		{
+			FirstLane = Lane;
+		}
+
+		bSameFeatures &= (InParams[Lane]->Features == InParams[FirstLane]->Features);
+		ActiveLanes |= (1 << Lane);
+		++NumActiveLanes;
+	}
+
+	if (NumActiveLanes == 0)
+	{
+		return;
+	}
+
+	// Lanes only share the code path when they are specialized on the same features
+	if (NumActiveLanes == 1 || bSameFeatures == false)
+	{
+		for (int32 Lane = 0; Lane < Lanes.Num(); ++Lane)
+		{
+			if (InParams[Lane])
+			{
+				Lanes[Lane]->DispatchSimulateBonesKernel(*InParams[Lane]);
+			}
+		}
+		return;
+	}
+
+	const uint32 Features = InParams[FirstLane]->Features;
+
+	Gather((Features & AnimPhysSolverFeatures::Wind) != 0);
+
+	static const FLaneKernel* Kernels = GetLaneKernels(TMakeIntegerSequence<uint32, AnimPhysSolverFeatures::Num>());
+	(this->*Kernels[Features])(InParams, ActiveLanes);
+
+	Scatter(ActiveLanes);
+}
+
+void FAnimPhys_LaneBatch::Gather(const bool bInWithWindNoise)
+{
+	const int32 NumBones = Lanes[0]->Simulated.Num();
+
+	Locations.SetNumZeroed(NumBones);
+	PrevLocations.SetNumZeroed(NumBones);
+	Velocities.SetNumZeroed(NumBones);
+	PoseLocations.SetNumZeroed(NumBones);
+	BoneLengths.SetNumZeroed(NumBones);
+	WindNoise.SetNumZeroed(bInWithWindNoise ? NumBones : 0);
+
+	for (int32 Lane = 0; Lane < Lanes.Num(); ++Lane)
+	{
+		const FAnimPhys_Simulated_WorkData& Simulated = Lanes[Lane]->Simulated;
+		check(Simulated.Num() == NumBones);
+
+		for (int32 BoneIndex = 0; BoneIndex < NumBones; ++BoneIndex)
+		{
+			AnimPhysLanes::SetLane(Locations[BoneIndex], Lane, Simulated.Locations[BoneIndex]);
+			AnimPhysLanes::SetLane(PrevLocations[BoneIndex], Lane, Simulated.PrevLocations[BoneIndex]);
+			AnimPhysLanes::SetLane(Velocities[BoneIndex], Lane, Simulated.Velocities[BoneIndex]);
+			AnimPhysLanes::SetLane(PoseLocations[BoneIndex], Lane, Simulated.PoseLocations[BoneIndex]);
+			BoneLengths[BoneIndex].V[Lane] = Simulated.BoneLengths[BoneIndex];
+		}
+
+		if (bInWithWindNoise)
+		{
+			const TArray<float>& LaneWindNoise = Lanes[Lane]->Forced.WindNoise;
+			for (int32 BoneIndex = 0; BoneIndex < NumBones; ++BoneIndex)
+			{
+				WindNoise[BoneIndex].V[Lane] = LaneWindNoise[BoneIndex];
+			}
+		}
+	}
+}
+
+void FAnimPhys_LaneBatch::Scatter(const uint32 InActiveLanes)
+{
+	// Locations are written back bone by bone by the kernel
+	const int32 NumBones = Locations.Num();
+	for (int32 Lane = 0; Lane < Lanes.Num(); ++Lane)
+	{
+		if ((InActiveLanes & (1 << Lane)) == 0)
+		{
+			continue;
+		}
+
+		FAnimPhys_Simulated_WorkData& Simulated = Lanes[Lane]->Simulated;
+		for (int32 BoneIndex = 0; BoneIndex < NumBones; ++BoneIndex)
+		{
+			Simulated.PrevLocations[BoneIndex] = AnimPhysLanes::GetLane(PrevLocations[BoneIndex], Lane);
+			Simulated.Velocities[BoneIndex] = AnimPhysLanes::GetLane(Velocities[BoneIndex], Lane);
+		}
+	}
+}
+
+template <uint32 InFeatures>
+void FAnimPhys_LaneBatch::SimulateBonesKernel(TConstArrayView<const FAnimPhys_SolverParams*> InParams, const uint32 InActiveLanes)
+{
+	using namespace AnimPhysLanes;
+
+	constexpr bool bDamping = (InFeatures & AnimPhysSolverFeatures::Damping) != 0;
+	constexpr bool bStiffness = (InFeatures & AnimPhysSolverFeatures::Stiffness) != 0;
+	constexpr bool bGravity = (InFeatures & AnimPhysSolverFeatures::Gravity) != 0;
+	constexpr bool bWind = (InFeatures & AnimPhysSolverFeatures::Wind) != 0;
+	constexpr bool bWorldDamping = (InFeatures & AnimPhysSolverFeatures::WorldDamping) != 0;
+	constexpr bool bWorldLocationMoved = (InFeatures & AnimPhysSolverFeatures::WorldLocationMoved) != 0;
+	constexpr bool bScaleDampingWithExternalSpeed = (InFeatures & AnimPhysSolverFeatures::ScaleDampingWithExternalSpeed) != 0;
+
+	const VectorRegister4Float DeltaTime = LoadParam(InParams, [](const FAnimPhys_SolverParams& P, int32) { return P.DeltaTime; });
+	const VectorRegister4Float InvLastDeltaTime = LoadParam(InParams, [](const FAnimPhys_SolverParams& P, int32) { return 1.0f / P.LastDeltaTime; });
+	const VectorRegister4Float DampingCoefficient = LoadParam(InParams, [](const FAnimPhys_SolverParams& P, int32) { return P.DampingCoefficient; });
+	const VectorRegister4Float StiffnessCoefficient = LoadParam(InParams, [](const FAnimPhys_SolverParams& P, int32) { return P.StiffnessCoefficient; });
+	const VectorRegister4Float WindCoefficient = LoadParam(InParams, [](const FAnimPhys_SolverParams& P, int32) { return P.TargetFramerate * P.DeltaTime; });
+	const VectorRegister4Float WorldRotationCoefficient = LoadParam(InParams, [](const FAnimPhys_SolverParams& P, int32) { return P.WorldDampingRotationCoefficient / P.LastDeltaTime * P.DeltaTime; });
+	const VectorRegister4Float WorldLocationSpeed = LoadParam(InParams, [](const FAnimPhys_SolverParams& P, int32) { return P.WorldLocationSpeed; });
+	const VectorRegister4Float ScaleDampingAlpha = LoadParam(InParams, [](const FAnimPhys_SolverParams& P, int32) { return FMath::Min(1.0f, P.DeltaTime * P.ScaleDampingLerpSpeed); });
+
+	const FVec GravityFactor = LoadParamVector(InParams, [](const FAnimPhys_SolverParams& P, int32) { return P.GravityFactor; });
+	const FVec WindFactor = LoadParamVector(InParams, [](const FAnimPhys_SolverParams& P, int32) { return P.WindFactor; });
+	const FVec WorldLocationDelta = LoadParamVector(InParams, [](const FAnimPhys_SolverParams& P, int32) { return P.WorldLocationVelocity * P.DeltaTime; });
+	const FVec ScaleDampingMultiplier = LoadParamVector(InParams, [](const FAnimPhys_SolverParams& P, int32) { return P.ScaleDampingMultiplier; });
+	const FVec Impulse = LoadParamVector(InParams, [this](const FAnimPhys_SolverParams&, int32 Lane) { return Lanes[Lane]->Forced.Impulse; });
+
+	const FVec WorldRotationAxis = LoadParamVector(InParams, [this](const FAnimPhys_SolverParams&, int32 Lane) { const FQuat& Q = Lanes[Lane]->Moved.WorldRotationDelta; return FVector(Q.X, Q.Y, Q.Z); });
+	const VectorRegister4Float WorldRotationW = LoadParam(InParams, [this](const FAnimPhys_SolverParams&, int32 Lane) { return static_cast<float>(Lanes[Lane]->Moved.WorldRotationDelta.W); });
+
+	const VectorRegister4Float StiffnessThreshold = VectorSetFloat1(0.01f);
+	const VectorRegister4Float Two = VectorSetFloat1(2.0f);
+
+	// Lanes that need the scalar collision and angle limit passes
+	uint32 CollisionLanes = 0;
+	uint32 AngleLimitLanes = 0;
+	for (int32 Lane = 0; Lane < Lanes.Num(); ++Lane)
+	{
+		const FAnimPhys_WorkData& WorkData = *Lanes[Lane];
+		if (WorkData.Collided.bSweptCollision || WorkData.Collided.Packed.IsEmpty() == false || WorkData.Collided.Floor.bValid)
+		{
+			CollisionLanes |= (1 << Lane);
+		}
+
+		if (WorkData.Simulated.AngleLimits.bConeEnabled || WorkData.Simulated.AngleLimits.bAxisEnabled)
+		{
+			AngleLimitLanes |= (1 << Lane);
+		}
+	}
+
+	const TArrayView<const FAnimPhys_SimulatedBone_Topology> Topology = Lanes[0]->Simulated.Topology;
+	const int32 NumBones = Topology.Num();
+
+	for (int32 BoneIndex = 0; BoneIndex < NumBones; ++BoneIndex)
+	{
+		const FAnimPhys_SimulatedBone_Topology& Bone = Topology[BoneIndex];
+
+		uint32 BoneLanes = InActiveLanes;
+		for (int32 Lane = 0; Lane < Lanes.Num(); ++Lane)
+		{
+			if (Lanes[Lane]->Simulated.Chains[Bone.ChainIndex].bSleeping)
+			{
+				BoneLanes &= ~(1 << Lane);
+			}
+		}
+
+		if (BoneLanes == 0)
+		{
+			continue;
+		}
+
+		const VectorRegister4Float BoneMask = MakeMask(BoneLanes);
+
+		const FVec OldBoneLocation = Load(Locations[BoneIndex]);
+		const FVec OldBonePrevLocation = Load(PrevLocations[BoneIndex]);
+		const FVec BonePoseLocation = Load(PoseLocations[BoneIndex]);
+
+		const int32 ParentIndex = Bone.ParentIndex;
+		if (ParentIndex == INDEX_NONE)
+		{
+			Store(Select(BoneMask, OldBoneLocation, OldBonePrevLocation), PrevLocations[BoneIndex]);
+			Store(Select(BoneMask, BonePoseLocation, OldBoneLocation), Locations[BoneIndex]);
+		}
+		else
+		{
+			const FVec ParentBoneLocation = Load(Locations[ParentIndex]);
+			const FVec ParentBonePrevLocation = Load(PrevLocations[ParentIndex]);
+			const FVec PoseDelta = Sub(BonePoseLocation, Load(PoseLocations[ParentIndex]));
+			const VectorRegister4Float BoneLength = VectorLoadAligned(BoneLengths[BoneIndex].V);
+
+			FVec BoneLocation = OldBoneLocation;
+			FVec BonePrevLocation = OldBonePrevLocation;
+
+			if constexpr (bDamping)
+			{
+				const FVec OldBoneVelocity = Load(Velocities[BoneIndex]);
+				FVec Velocity = Scale(Sub(BoneLocation, BonePrevLocation), InvLastDeltaTime);
+				FVec BoneVelocity;
+
+				if constexpr (bScaleDampingWithExternalSpeed)
+				{
+					if constexpr (bWorldDamping)
+					{
+						const VectorRegister4Float Speed = VectorSqrt(Dot(Velocity, Velocity));
+						const VectorRegister4Float Moving = VectorBitwiseAnd(VectorCompareGT(WorldLocationSpeed, VectorZeroFloat()), VectorCompareGT(Speed, VectorZeroFloat()));
+						const VectorRegister4Float SpeedScale = VectorMax(VectorOneFloat(), VectorDivide(WorldLocationSpeed, VectorMax(Speed, VectorSetFloat1(UE_SMALL_NUMBER))));
+						Velocity = Select(Moving, Mul(Scale(Velocity, SpeedScale), ScaleDampingMultiplier), Velocity);
+					}
+
+					BoneVelocity = ScaleAdd(Sub(Velocity, OldBoneVelocity), ScaleDampingAlpha, OldBoneVelocity);
+				}
+				else
+				{
+					BoneVelocity = Velocity;
+				}
+
+				Store(Select(BoneMask, BoneVelocity, OldBoneVelocity), Velocities[BoneIndex]);
+
+				BonePrevLocation = BoneLocation;
+				BoneLocation = ScaleAdd(BoneVelocity, DampingCoefficient, BoneLocation);
+			}
+			else
+			{
+				BonePrevLocation = BoneLocation;
+			}
+
+			FVec AccumulatedExternalDelta = Impulse;
+
+			// Wind
+			if constexpr (bWind)
+			{
+				AccumulatedExternalDelta = ScaleAdd(WindFactor, VectorMultiply(VectorLoadAligned(WindNoise[BoneIndex].V), WindCoefficient), AccumulatedExternalDelta);
+			}
+
+			// Follow Translation & Rotation
+			if constexpr (bWorldDamping)
+			{
+				AccumulatedExternalDelta = Add(AccumulatedExternalDelta, WorldLocationDelta);
+
+				// Same as FQuat::RotateVector
+				const FVec T = Scale(Cross(WorldRotationAxis, BonePrevLocation), Two);
+				const FVec Rotated = Add(ScaleAdd(T, WorldRotationW, BonePrevLocation), Cross(WorldRotationAxis, T));
+				AccumulatedExternalDelta = ScaleAdd(Sub(Rotated, BonePrevLocation), WorldRotationCoefficient, AccumulatedExternalDelta);
+			}
+
+			// Gravity
+			if constexpr (bGravity)
+			{
+				AccumulatedExternalDelta = Add(AccumulatedExternalDelta, GravityFactor);
+			}
+
+			// Prevent overextension
+			if constexpr (bWorldLocationMoved)
+			{
+				const FVec PrevDelta = Sub(BonePrevLocation, ParentBonePrevLocation);
+				BoneLocation = Add(BoneLocation, Sub(Scale(SafeNormal(Add(PrevDelta, AccumulatedExternalDelta)), BoneLength), PrevDelta));
+			}
+			else
+			{
+				BoneLocation = Add(BoneLocation, AccumulatedExternalDelta);
+				BoneLocation = ScaleAdd(SafeNormal(Sub(BoneLocation, ParentBoneLocation)), BoneLength, ParentBoneLocation);
+			}
+
+			// Pull to Pose Location
+			if constexpr (bStiffness)
+			{
+				const FVec BaseLocation = Add(ParentBoneLocation, PoseDelta);
+				BoneLocation = ScaleAdd(Sub(BaseLocation, BoneLocation), StiffnessCoefficient, BoneLocation);
+
+				if constexpr (bWorldLocationMoved == false)
+				{
+					const FVec Delta = Sub(BoneLocation, BaseLocation);
+					const VectorRegister4Float Near = VectorBitwiseAnd(VectorCompareLE(VectorAbs(Delta.X), StiffnessThreshold),
+						VectorBitwiseAnd(VectorCompareLE(VectorAbs(Delta.Y), StiffnessThreshold), VectorCompareLE(VectorAbs(Delta.Z), StiffnessThreshold)));
+					BoneLocation = Select(Near, BaseLocation, BoneLocation);
+				}
+			}
+
+			FAnimPhys_LaneVector& OutBoneLocation = Locations[BoneIndex];
+			Store(Select(BoneMask, BoneLocation, OldBoneLocation), OutBoneLocation);
+			Store(Select(BoneMask, BonePrevLocation, OldBonePrevLocation), PrevLocations[BoneIndex]);
+
+			// Colliders differ per instance, they are resolved lane by lane
+			const uint32 BoneCollisionLanes = (BoneLanes & CollisionLanes);
+			for (int32 Lane = 0; BoneCollisionLanes != 0 && Lane < Lanes.Num(); ++Lane)
+			{
+				if (BoneCollisionLanes & (1 << Lane))
+				{
+					const FAnimPhys_WorkData& WorkData = *Lanes[Lane];
+
+					FVector LaneBoneLocation = GetLane(OutBoneLocation, Lane);
+					if (WorkData.Collided.bSweptCollision)
+					{
+						WorkData.SweepBoneLocation(BoneIndex, WorkData.Simulated.Locations[BoneIndex], LaneBoneLocation);
+					}
+
+					WorkData.AdjustBoneLocation(BoneIndex, LaneBoneLocation);
+					SetLane(OutBoneLocation, Lane, LaneBoneLocation);
+				}
+			}
+
+			BoneLocation = ScaleAdd(SafeNormal(Sub(Load(OutBoneLocation), ParentBoneLocation)), BoneLength, ParentBoneLocation);
+			Store(Select(BoneMask, BoneLocation, OldBoneLocation), OutBoneLocation);
+
+			const uint32 BoneAngleLimitLanes = (BoneLanes & AngleLimitLanes);
+			for (int32 Lane = 0; BoneAngleLimitLanes != 0 && Lane < Lanes.Num(); ++Lane)
+			{
+				if (BoneAngleLimitLanes & (1 << Lane))
+				{
+					FVector LaneBoneLocation = GetLane(OutBoneLocation, Lane);
+					Lanes[Lane]->AdjustBoneDirection(GetLane(Locations[ParentIndex], Lane), BoneIndex, LaneBoneLocation);
+					SetLane(OutBoneLocation, Lane, LaneBoneLocation);
+				}
+			}
+		}
+
+		// The scalar passes of the children read their parents from the instances
+		for (int32 Lane = 0; Lane < Lanes.Num(); ++Lane)
+		{
+			if (BoneLanes & (1 << Lane))
+			{
+				FAnimPhys_Simulated_WorkData& Simulated = Lanes[Lane]->Simulated;
+				const FVector BoneLocation = GetLane(Locations[BoneIndex], Lane);
+
+				FAnimPhys_SimulatedChain_WorkData& Chain = Simulated.Chains[Bone.ChainIndex];
+				if (ParentIndex != INDEX_NONE)
+				{
+					Chain.MaxStepDeltaSquared = FMath::Max(Chain.MaxStepDeltaSquared, FVector::DistSquared(BoneLocation, Simulated.Locations[BoneIndex]));
+				}
+
+				Simulated.Locations[BoneIndex] = BoneLocation;
+			}
+		}
+	}
+}
@@ -0,0 +1,35 @@
+// Copyright NEXON Games Co., MIT License
+#include "AnimPhysQuality.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarAnimPhysQuality(
+	TEXT("sg.AnimPhysQuality"),
+	3,
+	TEXT("Scalability level of AnimPhys, usually set per platform by device profiles:\n")
+	TEXT(" 0: low, at most 30 Hz, one substep and iteration, spheres and capsules only, no angle limits, 32 bones per node\n")
+	TEXT(" 1: medium, at most 30 Hz, two substeps and iterations, no physics body collision, 64 bones per node\n")
+	TEXT(" 2: high, at most 60 Hz\n")
+	TEXT("The rate caps the fixed time step, nodes without fixed steps step every few frames instead\n")
+	TEXT(" 3: epic, as set up on the nodes"),
+	ECVF_ScalabilityGroup);
+
+namespace AnimPhysQuality
+{
+	static const FAnimPhysQuality Levels[] =
+	{
+		{ 30.0f, 1, 1, AnimPhysColliderTypes::Sphere | AnimPhysColliderTypes::Capsule, false, 32 },
+		{ 30.0f, 2, 2, AnimPhysColliderTypes::All & ~AnimPhysColliderTypes::PhysBody, true, 64 },
+		{ 60.0f, 4, 0, AnimPhysColliderTypes::All, true, 0 },
+		{ 0.0f, 0, 0, AnimPhysColliderTypes::All, true, 0 },
+	};
+
+	int32 GetLevel()
+	{
+		return FMath::Clamp(CVarAnimPhysQuality.GetValueOnAnyThread(), 0, static_cast<int32>(UE_ARRAY_COUNT(Levels)) - 1);
+	}
+
+	const FAnimPhysQuality& Get()
+	{
+		return Levels[GetLevel()];
+	}
+}
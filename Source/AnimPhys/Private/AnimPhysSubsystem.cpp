@@ -0,0 +1,366 @@
+// Copyright NEXON Games Co., MIT License
+#include "AnimPhysSubsystem.h"
+#include "AnimNode_AnimPhys.h"
+#include "AnimPhysLaneBatch.h"
+#include "AnimPhysInterface.h"
+#include "Async/ParallelFor.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("AnimPhys_BatchedSolve"), STAT_AnimPhys_BatchedSolve, STATGROUP_Anim);
+DECLARE_DWORD_COUNTER_STAT(TEXT("AnimPhys_BatchedNodes"), STAT_AnimPhys_BatchedNodes, STATGROUP_Anim);
+DECLARE_DWORD_COUNTER_STAT(TEXT("AnimPhys_BatchedBones"), STAT_AnimPhys_BatchedBones, STATGROUP_Anim);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("AnimPhys_BatchedBonesPerMsPerCore"), STAT_AnimPhys_BatchedBonesPerMsPerCore, STATGROUP_Anim);
+DECLARE_CYCLE_STAT(TEXT("AnimPhys_CopyBoneTransforms"), STAT_AnimPhys_CopyBoneTransforms, STATGROUP_Anim);
+DECLARE_DWORD_COUNTER_STAT(TEXT("AnimPhys_FrameNodes"), STAT_AnimPhys_FrameNodes, STATGROUP_Anim);
+DECLARE_CYCLE_STAT(TEXT("AnimPhys_Budget"), STAT_AnimPhys_Budget, STATGROUP_Anim);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("AnimPhys_BudgetPredictedMs"), STAT_AnimPhys_BudgetPredictedMs, STATGROUP_Anim);
+DECLARE_DWORD_COUNTER_STAT(TEXT("AnimPhys_DegradedNodes"), STAT_AnimPhys_DegradedNodes, STATGROUP_Anim);
+
+static TAutoConsoleVariable<float> CVarAnimPhysBudgetMs(TEXT("AnimPhys.Budget.Ms"), 0.0f, TEXT("Milliseconds per frame all AnimPhys nodes of a world may take, 0 disables the budget"));
+static TAutoConsoleVariable<int32> CVarAnimPhysBudgetTimeSlices(TEXT("AnimPhys.Budget.TimeSlices"), 4, TEXT("A time sliced AnimPhys node steps once every this many frames"));
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice AnimPhysBudgetDumpCommand(
+	TEXT("AnimPhys.Budget.Dump"),
+	TEXT("Lists the significance, estimated cost and degradation of the AnimPhys nodes of the last budget pass"),
+	FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+	{
+		if (const UAnimPhysSubsystem* Subsystem = World ? World->GetSubsystem<UAnimPhysSubsystem>() : nullptr)
+		{
+			Subsystem->DumpBudget(Ar);
+		}
+	}));
+
+namespace AnimPhysBudget
+{
+	// Share of the full cost a node still takes at each degradation
+	static float GetCostScale(const EAnimPhysDegradation InDegradation, const int32 InTimeSlices)
+	{
+		switch (InDegradation)
+		{
+		case EAnimPhysDegradation::FewerSubsteps:
+			return 0.75f;
+		case EAnimPhysDegradation::NoCollision:
+			return 0.5f;
+		case EAnimPhysDegradation::HalfRate:
+			return 0.25f;
+		case EAnimPhysDegradation::TimeSliced:
+			return 0.5f / InTimeSlices;
+		case EAnimPhysDegradation::Frozen:
+			return 0.05f;
+		default:
+			return 1.0f;
+		}
+	}
+
+	static uint32 GetRateDivisor(const EAnimPhysDegradation InDegradation, const int32 InTimeSlices)
+	{
+		switch (InDegradation)
+		{
+		case EAnimPhysDegradation::HalfRate:
+			return 2;
+		case EAnimPhysDegradation::TimeSliced:
+			return InTimeSlices;
+		default:
+			return 1;
+		}
+	}
+
+	// Rough share of the screen the mesh covers in the closest view, scaled down when it was not rendered
+	static float ComputeSignificance(const USkeletalMeshComponent* InMeshComponent, TConstArrayView<FVector> InViewLocations)
+	{
+		const float Radius = FMath::Max(1.0f, static_cast<float>(InMeshComponent->Bounds.SphereRadius));
+
+		float ScreenSize = InViewLocations.IsEmpty() ? 1.0f : 0.0f;
+		for (const FVector& ViewLocation : InViewLocations)
+		{
+			const float Distance = static_cast<float>(FVector::Dist(ViewLocation, InMeshComponent->Bounds.Origin));
+			ScreenSize = FMath::Max(ScreenSize, Radius / FMath::Max(Distance, Radius));
+		}
+
+		const float Visibility = InMeshComponent->WasRecentlyRendered() ? 1.0f : 0.1f;
+
+		float Importance = 1.0f;
+		if (const IAnimPhysActorInterface* ActorInterface = Cast<IAnimPhysActorInterface>(InMeshComponent->GetOwner()))
+		{
+			Importance = ActorInterface->GetAnimPhysImportance();
+		}
+
+		return ScreenSize * Visibility * Importance;
+	}
+}
+
+void UAnimPhysSubsystem::Deinitialize()
+{
+	FScopeLock Lock(&CriticalSection);
+	PendingNodes.Empty();
+	PendingFrameNodes.Empty();
+	RegisteredNodes.Empty();
+
+	Super::Deinitialize();
+}
+
+void UAnimPhysSubsystem::Tick(float DeltaTime)
+{
+	SolveBatchedNodes();
+
+	{
+		FScopeLock Lock(&CriticalSection);
+		Swap(FrameNodes, PendingFrameNodes);
+		FrameNodes.RemoveAllSwap([this](const FFrameNode& FrameNode) { return ensure(RegisteredNodes.Contains(FrameNode.Node)) == false; });
+	}
+
+	// After the solve, the copy overwrites the inputs it read
+	CopyBoneTransforms();
+
+	// Once every task of the frame is done, so all costs are measured
+	UpdateBudget();
+
+	FrameNodes.Reset();
+}
+
+void UAnimPhysSubsystem::SolveBatchedNodes()
+{
+	SCOPE_CYCLE_COUNTER(STAT_AnimPhys_BatchedSolve);
+
+	{
+		FScopeLock Lock(&CriticalSection);
+		Swap(SolvingNodes, PendingNodes);
+		SolvingNodes.RemoveAllSwap([this](const FAnimNode_AnimPhys* Node) { return ensure(RegisteredNodes.Contains(Node)) == false; });
+	}
+
+	if (SolvingNodes.IsEmpty())
+	{
+		return;
+	}
+
+	// Largest first, so the tail of the batch is made of small nodes.
+	// Nodes of the same setup end up next to each other and share SIMD lanes.
+	SolvingNodes.Sort([](const FAnimNode_AnimPhys& A, const FAnimNode_AnimPhys& B)
+	{
+		if (A.GetNumPendingBones() != B.GetNumPendingBones())
+		{
+			return A.GetNumPendingBones() > B.GetNumPendingBones();
+		}
+		return A.GetCompiledSetup() < B.GetCompiledSetup();
+	});
+
+	int32 NumBones = 0;
+	for (const FAnimNode_AnimPhys* Node : SolvingNodes)
+	{
+		NumBones += Node->GetNumPendingBones();
+	}
+
+	// Start of each lane group, plus the end of the last one
+	LaneGroupStarts.Reset();
+	for (int32 Index = 0; Index < SolvingNodes.Num(); ++Index)
+	{
+		const bool bStartsGroup = LaneGroupStarts.IsEmpty()
+			|| (Index - LaneGroupStarts.Last()) >= FAnimPhys_LaneBatch::NumLanes
+			|| SolvingNodes[Index]->CanSolveInLanesWith(*SolvingNodes[LaneGroupStarts.Last()]) == false;
+
+		if (bStartsGroup)
+		{
+			LaneGroupStarts.Add(Index);
+		}
+	}
+	LaneGroupStarts.Add(SolvingNodes.Num());
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	ParallelFor(LaneGroupStarts.Num() - 1, [this](int32 GroupIndex)
+	{
+		const int32 Start = LaneGroupStarts[GroupIndex];
+		const TArrayView<FAnimNode_AnimPhys*> Group = MakeArrayView(SolvingNodes).Slice(Start, LaneGroupStarts[GroupIndex + 1] - Start);
+
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		FAnimNode_AnimPhys::SolvePendingStepsInLanes(Group);
+
+		// Lanes share the cost evenly
+		const uint64 CostCycles = (FPlatformTime::Cycles64() - StartCycles) / Group.Num();
+		for (FAnimNode_AnimPhys* Node : Group)
+		{
+			Node->GetBudgetData().CostCycles += CostCycles;
+		}
+	}, EParallelForFlags::Unbalanced);
+
+	const double ElapsedMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+	const int32 NumCores = FMath::Min(SolvingNodes.Num(), FTaskGraphInterface::Get().GetNumWorkerThreads() + 1);
+
+	INC_DWORD_STAT_BY(STAT_AnimPhys_BatchedNodes, SolvingNodes.Num());
+	INC_DWORD_STAT_BY(STAT_AnimPhys_BatchedBones, NumBones);
+	SET_FLOAT_STAT(STAT_AnimPhys_BatchedBonesPerMsPerCore, (ElapsedMs > 0.0) ? (NumBones / (ElapsedMs * NumCores)) : 0.0);
+
+	SolvingNodes.Reset();
+}
+
+void UAnimPhysSubsystem::CopyBoneTransforms()
+{
+	SCOPE_CYCLE_COUNTER(STAT_AnimPhys_CopyBoneTransforms);
+
+	if (FrameNodes.IsEmpty())
+	{
+		return;
+	}
+
+	// The game thread waits on the pass, only the bone transforms of the components are read concurrently
+	ParallelFor(FrameNodes.Num(), [this](int32 Index)
+	{
+		FFrameNode& FrameNode = FrameNodes[Index];
+		FrameNode.Node->EndFrame(FrameNode.MeshComponent.Get(), FrameNode.bCopyBoneTransforms);
+	});
+
+	INC_DWORD_STAT_BY(STAT_AnimPhys_FrameNodes, FrameNodes.Num());
+}
+
+void UAnimPhysSubsystem::UpdateBudget()
+{
+	SCOPE_CYCLE_COUNTER(STAT_AnimPhys_Budget);
+
+	const float BudgetMs = CVarAnimPhysBudgetMs.GetValueOnGameThread();
+	const int32 TimeSlices = FMath::Max(2, CVarAnimPhysBudgetTimeSlices.GetValueOnGameThread());
+	const TConstArrayView<FVector> ViewLocations = GetWorld()->ViewLocationsRenderedLastFrame;
+
+	BudgetEntries.SetNum(FrameNodes.Num());
+	BudgetPredictedMs = 0.0f;
+
+	for (int32 Index = 0; Index < FrameNodes.Num(); ++Index)
+	{
+		FAnimPhys_BudgetData& BudgetData = FrameNodes[Index].Node->GetBudgetData();
+		const USkeletalMeshComponent* MeshComponent = FrameNodes[Index].MeshComponent.Get();
+
+		// Only full rate steps tell what the node costs without degradation
+		if (BudgetData.Degradation < EAnimPhysDegradation::HalfRate)
+		{
+			const float MeasuredMs = static_cast<float>(FPlatformTime::ToMilliseconds64(BudgetData.CostCycles));
+			const float FullCostMs = MeasuredMs / AnimPhysBudget::GetCostScale(BudgetData.Degradation, TimeSlices);
+			BudgetData.CostMs = (BudgetData.CostMs > 0.0f) ? FMath::Lerp(BudgetData.CostMs, FullCostMs, 0.25f) : FullCostMs;
+		}
+		BudgetData.CostCycles = 0;
+		BudgetData.Significance = MeshComponent ? AnimPhysBudget::ComputeSignificance(MeshComponent, ViewLocations) : 0.0f;
+
+		FBudgetEntry& Entry = BudgetEntries[Index];
+		Entry.MeshComponent = MeshComponent;
+		Entry.Significance = BudgetData.Significance;
+		Entry.CostMs = BudgetData.CostMs;
+		Entry.Degradation = EAnimPhysDegradation::None;
+
+		BudgetPredictedMs += BudgetData.CostMs;
+	}
+
+	// Degrade one step at a time, always the node whose significance weighs the least against how degraded it already is
+	if (BudgetMs > 0.0f && BudgetPredictedMs > BudgetMs)
+	{
+		struct FCandidate
+		{
+			float Priority;
+			int32 Index;
+
+			bool operator<(const FCandidate& Other) const { return Priority < Other.Priority; }
+		};
+
+		TArray<FCandidate> Candidates;
+		Candidates.Reserve(BudgetEntries.Num());
+		for (int32 Index = 0; Index < BudgetEntries.Num(); ++Index)
+		{
+			Candidates.Add({ BudgetEntries[Index].Significance, Index });
+		}
+		Candidates.Heapify();
+
+		while (BudgetPredictedMs > BudgetMs && Candidates.Num() > 0)
+		{
+			FCandidate Candidate;
+			Candidates.HeapPop(Candidate);
+
+			FBudgetEntry& Entry = BudgetEntries[Candidate.Index];
+			const float ScaleBefore = AnimPhysBudget::GetCostScale(Entry.Degradation, TimeSlices);
+			Entry.Degradation = static_cast<EAnimPhysDegradation>(static_cast<uint8>(Entry.Degradation) + 1);
+			BudgetPredictedMs -= Entry.CostMs * (ScaleBefore - AnimPhysBudget::GetCostScale(Entry.Degradation, TimeSlices));
+
+			if (Entry.Degradation != EAnimPhysDegradation::Frozen)
+			{
+				Candidates.HeapPush({ Entry.Significance * (static_cast<uint8>(Entry.Degradation) + 1), Candidate.Index });
+			}
+		}
+	}
+
+	int32 NumDegradedNodes = 0;
+	for (int32 Index = 0; Index < FrameNodes.Num(); ++Index)
+	{
+		FAnimPhys_BudgetData& BudgetData = FrameNodes[Index].Node->GetBudgetData();
+		BudgetData.Degradation = BudgetEntries[Index].Degradation;
+
+		// Nodes keep their phase while their rate does not change, new ones are spread round-robin
+		const uint32 RateDivisor = AnimPhysBudget::GetRateDivisor(BudgetData.Degradation, TimeSlices);
+		if (RateDivisor != BudgetData.RateDivisor)
+		{
+			BudgetData.RateDivisor = RateDivisor;
+			BudgetData.RatePhase = TimeSlicePhase++;
+		}
+
+		NumDegradedNodes += (BudgetData.Degradation != EAnimPhysDegradation::None) ? 1 : 0;
+	}
+
+	SET_FLOAT_STAT(STAT_AnimPhys_BudgetPredictedMs, BudgetPredictedMs);
+	INC_DWORD_STAT_BY(STAT_AnimPhys_DegradedNodes, NumDegradedNodes);
+}
+
+void UAnimPhysSubsystem::DumpBudget(FOutputDevice& Ar) const
+{
+	Ar.Logf(TEXT("AnimPhys budget %.3f ms, predicted %.3f ms, %d nodes"), CVarAnimPhysBudgetMs.GetValueOnGameThread(), BudgetPredictedMs, BudgetEntries.Num());
+
+	for (const FBudgetEntry& Entry : BudgetEntries)
+	{
+		const USkeletalMeshComponent* MeshComponent = Entry.MeshComponent.Get();
+		Ar.Logf(TEXT("  %-64s significance %8.4f, cost %7.3f ms, %s"),
+			MeshComponent ? *MeshComponent->GetReadableName() : TEXT("None"), Entry.Significance, Entry.CostMs, *UEnum::GetValueAsString(Entry.Degradation));
+	}
+}
+
+bool UAnimPhysSubsystem::IsBudgetEnabled()
+{
+	return CVarAnimPhysBudgetMs.GetValueOnGameThread() > 0.0f;
+}
+
+TStatId UAnimPhysSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UAnimPhysSubsystem, STATGROUP_Tickables);
+}
+
+void UAnimPhysSubsystem::Submit(FAnimNode_AnimPhys* InNode)
+{
+	FScopeLock Lock(&CriticalSection);
+	PendingNodes.Add(InNode);
+}
+
+void UAnimPhysSubsystem::Cancel(FAnimNode_AnimPhys* InNode)
+{
+	FScopeLock Lock(&CriticalSection);
+	PendingNodes.RemoveSwap(InNode);
+}
+
+void UAnimPhysSubsystem::RegisterNode(FAnimNode_AnimPhys* InNode)
+{
+	FScopeLock Lock(&CriticalSection);
+	RegisteredNodes.Add(InNode);
+}
+
+void UAnimPhysSubsystem::UnregisterNode(FAnimNode_AnimPhys* InNode)
+{
+	FScopeLock Lock(&CriticalSection);
+	RegisteredNodes.Remove(InNode);
+	PendingNodes.RemoveSwap(InNode);
+	PendingFrameNodes.RemoveAllSwap([InNode](const FFrameNode& FrameNode) { return FrameNode.Node == InNode; });
+}
+
+void UAnimPhysSubsystem::EnqueueFrameNode(FAnimNode_AnimPhys* InNode, USkeletalMeshComponent* InMeshComponent, const bool bInCopyBoneTransforms)
+{
+	FScopeLock Lock(&CriticalSection);
+	PendingFrameNodes.Add({ InNode, InMeshComponent, bInCopyBoneTransforms });
+}
+
+void UAnimPhysSubsystem::CancelFrameNode(FAnimNode_AnimPhys* InNode)
+{
+	FScopeLock Lock(&CriticalSection);
+	PendingFrameNodes.RemoveAllSwap([InNode](const FFrameNode& FrameNode) { return FrameNode.Node == InNode; });
+}
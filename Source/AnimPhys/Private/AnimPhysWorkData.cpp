@@ -30,7 +30,144 @@ SOFTWARE.
 
 #include "AnimPhysWorkData.h"
 
-void FAnimPhys_WorkData::BuildSimulatedBones(const FCompactPose& InPose, const TArray<FBoneReference>& InBonesToSimulate, const TArray<FBoneReference>& InBonesToExculude, const FAnimPhysSetupSettings& InSetupSettings)
+using FSimulateBonesKernel = void (FAnimPhys_WorkData::*)(const FAnimPhys_SolverParams&);
+
+template <uint32... InFeatures>
+static const FSimulateBonesKernel* GetSimulateBonesKernels(TIntegerSequence<uint32, InFeatures...>)
+{
+	static const FSimulateBonesKernel Kernels[] = { &FAnimPhys_WorkData::SimulateBonesKernel<InFeatures>... };
+	return Kernels;
+}
+
+void FAnimPhys_Simulated_WorkData::Init(const FAnimPhys_CompiledSetupPtr& InSetup)
+{
+	Setup = InSetup;
+	Topology = MakeArrayView(Setup->Topology);
+
+	const int32 NumBones = Topology.Num();
+	CompactPoseBoneIndexes.Init(FCompactPoseBoneIndex(INDEX_NONE), NumBones);
+	ValidBones.Init(false, NumBones);
+
+	Locations.Init(FVector::ZeroVector, NumBones);
+	PrevLocations.Init(FVector::ZeroVector, NumBones);
+	Velocities.Init(FVector::ZeroVector, NumBones);
+	PoseLocations.Init(FVector::ZeroVector, NumBones);
+	BoneLengths.Init(0.0f, NumBones);
+
+	PoseRotations.Init(FQuat::Identity, NumBones);
+	PoseScales.Init(FVector::OneVector, NumBones);
+	Rotations.Init(FQuat::Identity, NumBones);
+	LocalTransforms.Init(FTransform::Identity, NumBones);
+	SleepPoseLocations.Init(FVector::ZeroVector, NumBones);
+	SleepPoseRotations.Init(FQuat::Identity, NumBones);
+
+	DecimatedTopology = MakeArrayView(Setup->DecimatedBones);
+
+	const int32 NumDecimatedBones = DecimatedTopology.Num();
+	DecimatedCompactPoseBoneIndexes.Init(FCompactPoseBoneIndex(INDEX_NONE), NumDecimatedBones);
+	ValidDecimatedBones.Init(false, NumDecimatedBones);
+	DecimatedPoseTransforms.Init(FTransform::Identity, NumDecimatedBones);
+	DecimatedTransforms.Init(FTransform::Identity, NumDecimatedBones);
+	DecimatedLocalTransforms.Init(FTransform::Identity, NumDecimatedBones);
+
+	Chains.Reset(Setup->ChainRootIndexes.Num());
+	for (const int32 RootIndex : Setup->ChainRootIndexes)
+	{
+		Chains.AddDefaulted_GetRef().RootIndex = RootIndex;
+	}
+}
+
+void FAnimPhys_Simulated_WorkData::Empty()
+{
+	Setup.Reset();
+	Topology = TArrayView<const FAnimPhys_SimulatedBone_Topology>();
+	CompactPoseBoneIndexes.Empty();
+	ValidBones.Empty();
+
+	Locations.Empty();
+	PrevLocations.Empty();
+	Velocities.Empty();
+	PoseLocations.Empty();
+	BoneLengths.Empty();
+
+	PoseRotations.Empty();
+	PoseScales.Empty();
+	Rotations.Empty();
+	LocalTransforms.Empty();
+	SleepPoseLocations.Empty();
+	SleepPoseRotations.Empty();
+
+	DecimatedTopology = TArrayView<const FAnimPhys_DecimatedBone_Topology>();
+	DecimatedCompactPoseBoneIndexes.Empty();
+	ValidDecimatedBones.Empty();
+	DecimatedPoseTransforms.Empty();
+	DecimatedTransforms.Empty();
+	DecimatedLocalTransforms.Empty();
+
+	Chains.Empty();
+	CachedGeneration = INDEX_NONE;
+
+	LastStepLocations.Empty();
+	InterpolatedLocations.Empty();
+}
+
+FTransform FAnimPhys_Simulated_WorkData::GetPoseComponentSpaceTransform(int32 InIndex) const
+{
+	return FTransform(PoseRotations[InIndex], PoseLocations[InIndex], PoseScales[InIndex]);
+}
+
+void FAnimPhys_Simulated_WorkData::SetPoseComponentSpaceTransform(int32 InIndex, const FTransform& InPoseComponentSpaceTM)
+{
+	static const float PoseChangedThreshold = 0.01f;
+
+	const FVector PoseLocation = InPoseComponentSpaceTM.GetLocation();
+	const FQuat PoseRotation = InPoseComponentSpaceTM.GetRotation();
+
+	// Compared against the last pose while awake, which is the pose it falls asleep in
+	FAnimPhys_SimulatedChain_WorkData& Chain = Chains[Topology[InIndex].ChainIndex];
+	if (SleepPoseLocations[InIndex].Equals(PoseLocation, PoseChangedThreshold) == false || SleepPoseRotations[InIndex].Equals(PoseRotation) == false)
+	{
+		Chain.bPoseChanged = true;
+
+		// Woken right away, evaluations that do not step would keep applying the cached pose otherwise
+		Chain.NumFramesAtRest = 0;
+		Chain.bSleeping = false;
+		Chain.bHasCachedLocalTransforms = false;
+	}
+
+	if (Chain.bSleeping == false)
+	{
+		SleepPoseLocations[InIndex] = PoseLocation;
+		SleepPoseRotations[InIndex] = PoseRotation;
+	}
+
+	PoseLocations[InIndex] = PoseLocation;
+	PoseRotations[InIndex] = PoseRotation;
+	PoseScales[InIndex] = InPoseComponentSpaceTM.GetScale3D();
+}
+
+void FAnimPhys_Simulated_WorkData::ResetToPose(int32 InIndex)
+{
+	Locations[InIndex] = PoseLocations[InIndex];
+	PrevLocations[InIndex] = PoseLocations[InIndex];
+
+	if (LastStepLocations.IsValidIndex(InIndex))
+	{
+		LastStepLocations[InIndex] = PoseLocations[InIndex];
+	}
+}
+
+void FAnimPhys_Simulated_WorkData::WakeAllChains()
+{
+	for (auto& Chain : Chains)
+	{
+		Chain.NumFramesAtRest = 0;
+		Chain.bSleeping = false;
+		Chain.bHasCachedLocalTransforms = false;
+	}
+}
+
+void FAnimPhys_WorkData::BuildSimulatedBones(const FCompactPose& InPose, const TArray<FBoneReference>& InBonesToSimulate, const TArray<FBoneReference>& InBonesToExculude, const FAnimPhysSetupSettings& InSetupSettings, const int32 InMaxSimulatedBones, const int32 InDecimationStep, const bool bInAngleLimits)
 {
 	if (InBonesToSimulate.IsEmpty())
 	{
@@ -42,241 +179,341 @@ void FAnimPhys_WorkData::BuildSimulatedBones(const FCompactPose& InPose, const T
 		return;
 	}
 
-	TArray<FAnimPhys_SimulatedBone_WorkData> OldSimulateBones = MoveTemp(Simulated.SimulatedBones);
+	FAnimPhys_Simulated_WorkData OldSimulated = MoveTemp(Simulated);
 
+	Simulated.Empty();
 	Simulated.CapturedPoseBonesNum = InPose.GetNumBones();
-
-	Simulated.SimulatedBones.Empty();
+	Simulated.MaxSimulatedBones = InMaxSimulatedBones;
+	Simulated.DecimationStep = InDecimationStep;
+	Simulated.CachedGeneration = Cached.Generation;
+	Simulated.AngleLimits.Set(InSetupSettings, bInAngleLimits);
 
 	const FBoneContainer& RequiredBones = InPose.GetBoneContainer();
 
-	TMap<FCompactPoseBoneIndex, int32> SimulatedBoneMap;
-	TArray<FCompactPoseBoneIndex> ParentBones;
-	for (const auto& EachRootBone : InBonesToSimulate)
+	Simulated.Init(AnimPhysCompiledSetup::FindOrCompile(RequiredBones, InBonesToSimulate, InBonesToExculude, InSetupSettings.EndBoneLength > 0.0f, InMaxSimulatedBones, InDecimationStep));
+
+	for (auto& Chain : Simulated.Chains)
 	{
-		if (EachRootBone.IsValidToEvaluate() == false)
+		Chain.ParentCachedSlot = Cached.FindSlot(Simulated.Topology[Chain.RootIndex].ParentMeshPoseBoneIndex);
+	}
+
+	// Parents always come before their children, so one pass is enough
+	for (int32 SimulatedBoneIndex = 0; SimulatedBoneIndex < Simulated.Num(); ++SimulatedBoneIndex)
+	{
+		const FAnimPhys_SimulatedBone_Topology& SimulatedBone = Simulated.Topology[SimulatedBoneIndex];
+
+		// End bones
+		if (SimulatedBone.MeshPoseBoneIndex.IsValid() == false)
+		{
+			if (Simulated.ValidBones[SimulatedBone.ParentIndex] == false)
+			{
+				continue;
+			}
+
+			FTransform EndBonePoseTM = Simulated.GetPoseComponentSpaceTransform(SimulatedBone.ParentIndex);
+			EndBonePoseTM.SetLocation(EndBonePoseTM.GetLocation() + EndBonePoseTM.GetRotation().GetForwardVector() * InSetupSettings.EndBoneLength);
+
+			Simulated.SetPoseComponentSpaceTransform(SimulatedBoneIndex, EndBonePoseTM);
+			Simulated.ResetToPose(SimulatedBoneIndex);
+			Simulated.BoneLengths[SimulatedBoneIndex] = InSetupSettings.EndBoneLength;
+			Simulated.ValidBones[SimulatedBoneIndex] = true;
+			continue;
+		}
+
+		const FCompactPoseBoneIndex CompactPoseBoneIndex = RequiredBones.MakeCompactPoseIndex(SimulatedBone.MeshPoseBoneIndex);
+		if (InPose.IsValidIndex(CompactPoseBoneIndex) == false)
 		{
 			continue;
 		}
 
-		FCompactPoseBoneIndex CompactPoseIndex = EachRootBone.GetCompactPoseIndex(RequiredBones);
-		ParentBones.Add(CompactPoseIndex);
+		Simulated.CompactPoseBoneIndexes[SimulatedBoneIndex] = CompactPoseBoneIndex;
+
+		CalculatePoseComponentSpace(InPose, InSetupSettings, SimulatedBoneIndex);
+
+		Simulated.ResetToPose(SimulatedBoneIndex);
+		Simulated.ValidBones[SimulatedBoneIndex] = true;
+
+		// Below a decimated bone the length is the distance to the simulated parent, already set above
+		if (SimulatedBone.DecimatedParentIndex == INDEX_NONE)
+		{
+			Simulated.BoneLengths[SimulatedBoneIndex] = InPose[CompactPoseBoneIndex].GetLocation().Size();
+		}
+	}
+
+	CalculateDecimatedPoseComponentSpace(InPose);
 
-		FAnimPhys_SimulatedBone_WorkData NewRootBone;
-		NewRootBone.CompactPoseBoneIndex = EachRootBone.GetCompactPoseIndex(RequiredBones);
-		NewRootBone.MeshPoseBoneIndex = EachRootBone.GetMeshPoseIndex(RequiredBones);
+	CopyFromOldSimulateBones(OldSimulated);
+}
 
-		const int32 Index = Simulated.SimulatedBones.Add(NewRootBone);
+void FAnimPhys_WorkData::CopyFromOldSimulateBones(const FAnimPhys_Simulated_WorkData& OldSimulated)
+{
+	if (OldSimulated.IsEmpty())
+	{
+		return;
+	}
 
-		SimulatedBoneMap.Add(CompactPoseIndex, Index);
+	if (OldSimulated.Setup == Simulated.Setup)
+	{
+		Simulated.Locations = OldSimulated.Locations;
+		Simulated.PrevLocations = OldSimulated.PrevLocations;
+		Simulated.Velocities = OldSimulated.Velocities;
+		return;
 	}
 
-	TArray<FCompactPoseBoneIndex> ExcludedParentBones;
-	for (const auto& EachRootBone : InBonesToExculude)
+	// The required bones changed (e.g. LOD), carry over the bones both setups simulate.
+	// End bones are keyed by their parent, shifted below INDEX_NONE.
+	auto GetBoneKey = [](const FAnimPhys_Simulated_WorkData& InSimulated, const int32 InIndex)
 	{
-		if (EachRootBone.IsValidToEvaluate() == false)
+		const FAnimPhys_SimulatedBone_Topology& Bone = InSimulated.Topology[InIndex];
+		if (Bone.MeshPoseBoneIndex.IsValid())
 		{
-			continue;
+			return Bone.MeshPoseBoneIndex.GetInt();
 		}
 
-		FCompactPoseBoneIndex CompactPoseIndex = EachRootBone.GetCompactPoseIndex(RequiredBones);
-		ExcludedParentBones.Add(CompactPoseIndex);
+		return -2 - InSimulated.Topology[Bone.ParentIndex].MeshPoseBoneIndex.GetInt();
+	};
+
+	TMap<int32, int32> OldBoneMap;
+	OldBoneMap.Reserve(OldSimulated.Num());
+	for (int32 OldIndex = 0; OldIndex < OldSimulated.Num(); ++OldIndex)
+	{
+		if (OldSimulated.ValidBones[OldIndex])
+		{
+			OldBoneMap.Add(GetBoneKey(OldSimulated, OldIndex), OldIndex);
+		}
 	}
 
-	FCompactPoseBoneIndex BoneIndex(0);
-	while (BoneIndex.GetInt() != RequiredBones.GetCompactPoseNumBones())
+	// Bones that were decimated start from where they were last applied
+	TMap<int32, int32> OldDecimatedBoneMap;
+	OldDecimatedBoneMap.Reserve(OldSimulated.DecimatedTopology.Num());
+	for (int32 OldIndex = 0; OldIndex < OldSimulated.DecimatedTopology.Num(); ++OldIndex)
 	{
-		bool ShouldExclude = false;
-		for (const auto& ExcludedParentBone : ExcludedParentBones)
+		if (OldSimulated.ValidDecimatedBones[OldIndex])
 		{
-			if (RequiredBones.BoneIsChildOf(BoneIndex, ExcludedParentBone))
-			{
-				ShouldExclude = true;
-				break;
-			}
+			OldDecimatedBoneMap.Add(OldSimulated.DecimatedTopology[OldIndex].MeshPoseBoneIndex.GetInt(), OldIndex);
 		}
-		if (ShouldExclude)
+	}
+
+	for (int32 BoneIndex = 0; BoneIndex < Simulated.Num(); ++BoneIndex)
+	{
+		if (Simulated.ValidBones[BoneIndex] == false)
 		{
-			++BoneIndex;
 			continue;
 		}
 
-		bool FoundChild = false;
-		for (const auto& ParentBone : ParentBones)
+		const int32* OldIndex = OldBoneMap.Find(GetBoneKey(Simulated, BoneIndex));
+		if (OldIndex == nullptr)
 		{
-			if (RequiredBones.BoneIsChildOf(BoneIndex, ParentBone))
+			if (const int32* OldDecimatedIndex = OldDecimatedBoneMap.Find(GetBoneKey(Simulated, BoneIndex)))
 			{
-				FoundChild = true;
-				break;
+				Simulated.Locations[BoneIndex] = OldSimulated.DecimatedTransforms[*OldDecimatedIndex].GetLocation();
+				Simulated.PrevLocations[BoneIndex] = Simulated.Locations[BoneIndex];
 			}
-		}
-		if (FoundChild == false)
-		{
-			++BoneIndex;
 			continue;
 		}
 
-		const int32* ParentIndex = SimulatedBoneMap.Find(RequiredBones.GetParentBoneIndex(BoneIndex));
-		if (ParentIndex && Simulated.SimulatedBones.IsValidIndex(*ParentIndex))
-		{
-			FAnimPhys_SimulatedBone_WorkData NewChildBone;
-			NewChildBone.ParentIndex = (*ParentIndex);
-			NewChildBone.CompactPoseBoneIndex = BoneIndex;
-			NewChildBone.MeshPoseBoneIndex = RequiredBones.MakeMeshPoseIndex(BoneIndex);
+		Simulated.Locations[BoneIndex] = OldSimulated.Locations[*OldIndex];
+		Simulated.PrevLocations[BoneIndex] = OldSimulated.PrevLocations[*OldIndex];
+		Simulated.Velocities[BoneIndex] = OldSimulated.Velocities[*OldIndex];
+	}
+}
 
-			const int32 SimulatedBoneIndex = Simulated.SimulatedBones.Add(NewChildBone);
-			SimulatedBoneMap.Add(BoneIndex, SimulatedBoneIndex);
 
-			Simulated.SimulatedBones[NewChildBone.ParentIndex].NumChildren += 1;
-			Simulated.SimulatedBones[NewChildBone.ParentIndex].LastChildIndex = SimulatedBoneIndex;
-		}
+void FAnimPhys_WorkData::ResolveCachedSlots()
+{
+	if (Collided.CachedGeneration != Cached.Generation)
+	{
+		auto ResolveSlots = [this](auto& InColliders)
+		{
+			for (auto& Collider : InColliders)
+			{
+				Collider.CachedSlot = Collider.Definition->bFromAttachedMesh ? Cached.FindAttachedSlot(Collider.Definition->MeshPoseBoneIndex) : Cached.FindSlot(Collider.Definition->MeshPoseBoneIndex);
+			}
+		};
 
-		++BoneIndex;
-	}
+		ResolveSlots(Collided.Spheres);
+		ResolveSlots(Collided.Capsules);
+		ResolveSlots(Collided.Planars);
+		ResolveSlots(Collided.PhysBodySpheres);
+		ResolveSlots(Collided.PhysBodyCapsules);
 
-	const bool ShouldBuildEndBone = (InSetupSettings.EndBoneLength > 0.0f && ExcludedParentBones.IsEmpty());
-	TArray<int32> EndBoneParentIndexes;
+		Collided.CachedGeneration = Cached.Generation;
+	}
 
-	for (int32 SimulatedBoneIndex = 0; SimulatedBoneIndex < Simulated.SimulatedBones.Num(); ++SimulatedBoneIndex)
+	if (Simulated.CachedGeneration != Cached.Generation)
 	{
-		auto& SimulatedBone = Simulated.SimulatedBones[SimulatedBoneIndex];
-		if (InPose.IsValidIndex(SimulatedBone.CompactPoseBoneIndex) == false)
+		for (auto& Chain : Simulated.Chains)
 		{
-			continue;
+			Chain.ParentCachedSlot = Cached.FindSlot(Simulated.Topology[Chain.RootIndex].ParentMeshPoseBoneIndex);
 		}
 
-		SimulatedBone.CompactPoseBoneIndex = RequiredBones.MakeCompactPoseIndex(SimulatedBone.MeshPoseBoneIndex);
-
-		CalculatePoseComponentSpace(InPose, InSetupSettings, SimulatedBone);
+		Simulated.CachedGeneration = Cached.Generation;
+	}
+}
 
-		SimulatedBone.ComponentSpaceTM = SimulatedBone.PoseComponentSpaceTM;
-		SimulatedBone.PrevLocation = SimulatedBone.PoseComponentSpaceTM.GetLocation();
+bool FAnimPhys_WorkData::TryGetPoseComponentSpaceTransform(const int32 InCachedSlot, FTransform& OutPoseComponentSpaceTM) const
+{
+	if (Cached.ComponentSpaceTMs.IsValidIndex(InCachedSlot) == false)
+	{
+		return false;
+	}
 
-		SimulatedBone.BoneLengthToParent = InPose[SimulatedBone.CompactPoseBoneIndex].GetLocation().Size();
+	OutPoseComponentSpaceTM = Cached.ComponentSpaceTMs[InCachedSlot];
+	return true;
+}
 
-		SimulatedBone.bValid = true;
+void FAnimPhys_WorkData::CalculatePoseComponentSpace(const FCompactPose& InPose, const FAnimPhysSetupSettings& InSetupSettings, const int32 InBoneIndex)
+{
+	const FAnimPhys_SimulatedBone_Topology& Bone = Simulated.Topology[InBoneIndex];
+	const FCompactPoseBoneIndex CompactPoseBoneIndex = Simulated.CompactPoseBoneIndexes[InBoneIndex];
 
-		if (ShouldBuildEndBone && SimulatedBone.NumChildren == 0)
+	if (CompactPoseBoneIndex.IsValid() && Bone.ParentIndex == INDEX_NONE)
+	{
+		FTransform ParentPoseComponentSpcaeTM;
+		if (TryGetPoseComponentSpaceTransform(Simulated.Chains[Bone.ChainIndex].ParentCachedSlot, ParentPoseComponentSpcaeTM))
 		{
-			EndBoneParentIndexes.Add(SimulatedBoneIndex);
+			check(InPose.IsValidIndex(CompactPoseBoneIndex));
+			Simulated.SetPoseComponentSpaceTransform(InBoneIndex, InPose[CompactPoseBoneIndex] * ParentPoseComponentSpcaeTM);
+			Simulated.BoneLengths[InBoneIndex] = (InPose[CompactPoseBoneIndex].GetLocation() * ParentPoseComponentSpcaeTM.GetScale3D()).Size();
+			Simulated.ValidBones[InBoneIndex] = true;
 		}
 	}
-
-	if (ShouldBuildEndBone)
+	else if (Simulated.IsValidIndex(Bone.ParentIndex))
 	{
-		int32 NewCapacity = Simulated.SimulatedBones.Num() + EndBoneParentIndexes.Num();
-		Simulated.SimulatedBones.Reserve(NewCapacity);
-		for (int32& EndBoneParentIndex : EndBoneParentIndexes)
+		if (Simulated.ValidBones[Bone.ParentIndex])
 		{
-			if (Simulated.SimulatedBones.IsValidIndex(EndBoneParentIndex))
-			{
-				const auto& ParentBone = Simulated.SimulatedBones[EndBoneParentIndex];
+			const FTransform ParentPoseComponentSpaceTM = Simulated.GetPoseComponentSpaceTransform(Bone.ParentIndex);
 
-				FAnimPhys_SimulatedBone_WorkData NewEndBone;
-				NewEndBone.ParentIndex = EndBoneParentIndex;
-
-				const FVector EndBoneLocation = ParentBone.PoseComponentSpaceTM.GetLocation() + ParentBone.PoseComponentSpaceTM.GetRotation().GetForwardVector() * InSetupSettings.EndBoneLength;
-				NewEndBone.PoseComponentSpaceTM = ParentBone.PoseComponentSpaceTM;
-				NewEndBone.PoseComponentSpaceTM.SetLocation(EndBoneLocation);
-
-				NewEndBone.ComponentSpaceTM = NewEndBone.PoseComponentSpaceTM;
-				NewEndBone.PrevLocation = NewEndBone.PoseComponentSpaceTM.GetLocation();
-
-				NewEndBone.BoneLengthToParent = InSetupSettings.EndBoneLength;
-
-				NewEndBone.bValid = true;
+			if (CompactPoseBoneIndex.IsValid() && Bone.DecimatedParentIndex != INDEX_NONE)
+			{
+				if (CalculateDecimatedPoseComponentSpace(InPose, Bone.DecimatedParentIndex))
+				{
+					check(InPose.IsValidIndex(CompactPoseBoneIndex));
+					const FTransform PoseComponentSpaceTM = InPose[CompactPoseBoneIndex] * Simulated.DecimatedPoseTransforms[Bone.DecimatedParentIndex];
+					Simulated.SetPoseComponentSpaceTransform(InBoneIndex, PoseComponentSpaceTM);
+					Simulated.BoneLengths[InBoneIndex] = FVector::Dist(PoseComponentSpaceTM.GetLocation(), ParentPoseComponentSpaceTM.GetLocation());
+					Simulated.ValidBones[InBoneIndex] = true;
+				}
+			}
+			else if (CompactPoseBoneIndex.IsValid())
+			{
+				check(InPose.IsValidIndex(CompactPoseBoneIndex));
+				const FTransform PoseComponentSpaceTM = InPose[CompactPoseBoneIndex] * ParentPoseComponentSpaceTM;
+				Simulated.SetPoseComponentSpaceTransform(InBoneIndex, PoseComponentSpaceTM);
+				Simulated.BoneLengths[InBoneIndex] = (InPose[CompactPoseBoneIndex].GetLocation() * PoseComponentSpaceTM.GetScale3D()).Size();
+				Simulated.ValidBones[InBoneIndex] = true;
+			}
+			else
+			{
+				FTransform PoseComponentSpaceTM = ParentPoseComponentSpaceTM;
 
-				const int32 SimulatedBoneIndex = Simulated.SimulatedBones.Add(NewEndBone);
+				const FVector EndBoneLocation = ParentPoseComponentSpaceTM.GetLocation() + ParentPoseComponentSpaceTM.GetRotation().GetForwardVector() * InSetupSettings.EndBoneLength;
+				PoseComponentSpaceTM.SetLocation(EndBoneLocation);
 
-				Simulated.SimulatedBones[NewEndBone.ParentIndex].NumChildren += 1;
-				Simulated.SimulatedBones[NewEndBone.ParentIndex].LastChildIndex = SimulatedBoneIndex;
+				Simulated.SetPoseComponentSpaceTransform(InBoneIndex, PoseComponentSpaceTM);
+				Simulated.ValidBones[InBoneIndex] = true;
 			}
 		}
 	}
-
-	CopyFromOldSimulateBones(OldSimulateBones);
 }
 
-void FAnimPhys_WorkData::CopyFromOldSimulateBones(const TArray<FAnimPhys_SimulatedBone_WorkData>& OldSimulateBones)
+void FAnimPhys_WorkData::CalculateDecimatedPoseComponentSpace(const FCompactPose& InPose)
 {
-	if (OldSimulateBones.Num() != Simulated.SimulatedBones.Num())
+	for (int32 DecimatedIndex = 0; DecimatedIndex < Simulated.DecimatedTopology.Num(); ++DecimatedIndex)
 	{
-		return;
+		CalculateDecimatedPoseComponentSpace(InPose, DecimatedIndex);
 	}
+}
 
-	for (int32 SimulatedBoneIndex = 0; SimulatedBoneIndex < Simulated.SimulatedBones.Num(); ++SimulatedBoneIndex)
+bool FAnimPhys_WorkData::CalculateDecimatedPoseComponentSpace(const FCompactPose& InPose, const int32 InDecimatedIndex)
+{
+	if (Simulated.ValidDecimatedBones[InDecimatedIndex])
 	{
-		auto& SimulatedBone = Simulated.SimulatedBones[SimulatedBoneIndex];
-		SimulatedBone.ComponentSpaceTM = OldSimulateBones[SimulatedBoneIndex].ComponentSpaceTM;
-		SimulatedBone.PrevLocation = OldSimulateBones[SimulatedBoneIndex].PrevLocation;
+		return true;
 	}
-}
 
+	const FAnimPhys_DecimatedBone_Topology& Bone = Simulated.DecimatedTopology[InDecimatedIndex];
+	const FCompactPoseBoneIndex CompactPoseBoneIndex = InPose.GetBoneContainer().MakeCompactPoseIndex(Bone.MeshPoseBoneIndex);
 
-bool FAnimPhys_WorkData::TryGetPoseComponentSpaceTransform(const FMeshPoseBoneIndex& InMeshPoseBoneIndex, FTransform& OutPoseComponentSpaceTM) const
-{
-	if (InMeshPoseBoneIndex.IsValid() == false)
+	Simulated.DecimatedCompactPoseBoneIndexes[InDecimatedIndex] = CompactPoseBoneIndex;
+	if (InPose.IsValidIndex(CompactPoseBoneIndex) == false)
 	{
 		return false;
 	}
 
-	const FTransform* Found = Cached.ComponentSpaceTMs.Find(InMeshPoseBoneIndex);
-	if (Found == nullptr)
+	// At most DecimationStep - 1 decimated bones up to the simulated parent
+	FTransform ParentPoseComponentSpaceTM;
+	if (Bone.DecimatedParentIndex != INDEX_NONE)
 	{
-		return false;
+		if (CalculateDecimatedPoseComponentSpace(InPose, Bone.DecimatedParentIndex) == false)
+		{
+			return false;
+		}
+
+		ParentPoseComponentSpaceTM = Simulated.DecimatedPoseTransforms[Bone.DecimatedParentIndex];
+	}
+	else
+	{
+		if (Simulated.ValidBones[Bone.SimulatedParentIndex] == false)
+		{
+			return false;
+		}
+
+		ParentPoseComponentSpaceTM = Simulated.GetPoseComponentSpaceTransform(Bone.SimulatedParentIndex);
 	}
 
-	OutPoseComponentSpaceTM = (*Found);
+	Simulated.DecimatedPoseTransforms[InDecimatedIndex] = InPose[CompactPoseBoneIndex] * ParentPoseComponentSpaceTM;
+	Simulated.ValidDecimatedBones[InDecimatedIndex] = true;
 	return true;
 }
 
-void FAnimPhys_WorkData::CalculatePoseComponentSpace(const FCompactPose& InPose, const FAnimPhysSetupSettings& InSetupSettings, FAnimPhys_SimulatedBone_WorkData& OutBone) const
+void FAnimPhys_WorkData::UpdateSleepingChains(const bool bInputsAtRest, const FAnimPhysSimulationSettings& InSimulationSettings)
 {
-	const FBoneContainer& RequiredBones = InPose.GetBoneContainer();
+	const float SleepThresholdSquared = FMath::Square(InSimulationSettings.SleepThreshold);
 
-	if (OutBone.CompactPoseBoneIndex.IsValid() && OutBone.ParentIndex == INDEX_NONE)
+	for (auto& Chain : Simulated.Chains)
 	{
-		FTransform ParentPoseComponentSpcaeTM;
-		const FMeshPoseBoneIndex ParentMeshPoseBoneIndex = RequiredBones.MakeMeshPoseIndex(RequiredBones.GetParentBoneIndex(OutBone.CompactPoseBoneIndex));
-		if (TryGetPoseComponentSpaceTransform(ParentMeshPoseBoneIndex, ParentPoseComponentSpcaeTM))
+		const bool bCanSleep = (InSimulationSettings.bAllowSleep && bInputsAtRest && Chain.bPoseChanged == false);
+		if (bCanSleep == false)
 		{
-			check(InPose.IsValidIndex(OutBone.CompactPoseBoneIndex));
-			OutBone.PoseComponentSpaceTM = InPose[OutBone.CompactPoseBoneIndex] * ParentPoseComponentSpcaeTM;
-			OutBone.BoneLengthToParent = (InPose[OutBone.CompactPoseBoneIndex].GetLocation() * ParentPoseComponentSpcaeTM.GetScale3D()).Size() ;
-			OutBone.bValid = true;
+			Chain.NumFramesAtRest = 0;
+			Chain.bSleeping = false;
 		}
-	}
-	else if (Simulated.SimulatedBones.IsValidIndex(OutBone.ParentIndex))
-	{
-		const auto& ParentBone = Simulated.SimulatedBones[OutBone.ParentIndex];
-		if (ParentBone.bValid)
+		else if (Chain.bSleeping == false)
 		{
-			if (OutBone.CompactPoseBoneIndex.IsValid())
-			{
-				check(InPose.IsValidIndex(OutBone.CompactPoseBoneIndex));
-				OutBone.PoseComponentSpaceTM = InPose[OutBone.CompactPoseBoneIndex] * ParentBone.PoseComponentSpaceTM;
-				OutBone.BoneLengthToParent = (InPose[OutBone.CompactPoseBoneIndex].GetLocation() * OutBone.PoseComponentSpaceTM.GetScale3D()).Size();
-				OutBone.bValid = true;
-			}
-			else
-			{
-				OutBone.PoseComponentSpaceTM = ParentBone.PoseComponentSpaceTM;
-
-				const FVector EndBoneLocation = ParentBone.PoseComponentSpaceTM.GetLocation() + ParentBone.PoseComponentSpaceTM.GetRotation().GetForwardVector() * InSetupSettings.EndBoneLength;
-				OutBone.PoseComponentSpaceTM.SetLocation(EndBoneLocation);
+			Chain.NumFramesAtRest = (Chain.MaxStepDeltaSquared <= SleepThresholdSquared) ? (Chain.NumFramesAtRest + 1) : 0;
+			Chain.bSleeping = (Chain.NumFramesAtRest >= InSimulationSettings.SleepFrames);
+		}
 
-				OutBone.bValid = true;
-			}
+		if (Chain.bSleeping == false)
+		{
+			Chain.bHasCachedLocalTransforms = false;
 		}
+
+		Chain.MaxStepDeltaSquared = 0.0f;
+		Chain.bPoseChanged = false;
+	}
+}
+
+void FAnimPhys_WorkData::SimulateBones(const float& InDeltaTime, const float InLastDeltaTime, const float& InTargetFramerate, const FAnimPhysSetupSettings& InSetupSettings, const FAnimPhysExternalForceSettings& InExternalForceSettings, const FAnimPhysSmoothingSettings& InSmoothingSettings, const FAnimPhysSimulationSettings& InSimulationSettings)
+{
+	FAnimPhys_SolverParams Params;
+	if (PrepareSimulateBones(InDeltaTime, InLastDeltaTime, InTargetFramerate, InSetupSettings, InExternalForceSettings, InSmoothingSettings, InSimulationSettings, Params) == false)
+	{
+		return;
 	}
+
+	DispatchSimulateBonesKernel(Params);
+
+	Simulated.NumConstraintIterations = RelaxConstraints(InSimulationSettings.ConstraintIterations, InSimulationSettings.ConstraintTolerance);
 }
 
-void FAnimPhys_WorkData::SimulateBones(const FCompactPose& InPose, const float& InDeltaTime, const float InLastDeltaTime, const float& InTargetFramerate, const FAnimPhysSetupSettings& InSetupSettings, const FAnimPhysExternalForceSettings& InExternalForceSettings, const FAnimPhysSmoothingSettings& InSmoothingSettings)
+bool FAnimPhys_WorkData::PrepareSimulateBones(const float& InDeltaTime, const float InLastDeltaTime, const float& InTargetFramerate, const FAnimPhysSetupSettings& InSetupSettings, const FAnimPhysExternalForceSettings& InExternalForceSettings, const FAnimPhysSmoothingSettings& InSmoothingSettings, const FAnimPhysSimulationSettings& InSimulationSettings, FAnimPhys_SolverParams& OutParams)
 {
 	const bool bValidDeltaTime = (InDeltaTime > 0.0f && InLastDeltaTime > 0.0f);
 	if (bValidDeltaTime == false)
 	{
-		return;
+		return false;
 	}
 
 	// for Gravity
@@ -314,53 +551,114 @@ void FAnimPhys_WorkData::SimulateBones(const FCompactPose& InPose, const float&
 	}
 
 	const bool bWorldLocationMoved = (WorldLocationSpeed > 0.0f);
-	const float DampingCoefficient = Simulated.bDampingEnabled ? (1.0f - InSetupSettings.Damping) * InDeltaTime : 0.0f;
-	const float StiffnessCoefficient = Simulated.bStiffnessEnabled ? FMath::Clamp((1.0f - FMath::Pow(1.0f - InSetupSettings.Stiffness, InTargetFramerate * InDeltaTime)), 0.0f, 1.0f) : 0.0f;
 
-	for (auto& Bone : Simulated.SimulatedBones)
+	if (Simulated.bWindEnabled)
 	{
-		if (Bone.ParentIndex == INDEX_NONE)
+		Forced.GenerateWindNoise(Simulated.Num());
+	}
+
+	const bool bInputsAtRest = (Moved.WorldLocationDelta.IsNearlyZero() && Moved.WorldRotationDelta.Equals(FQuat::Identity) && WindFactor.IsNearlyZero() && Forced.Impulse.IsNearlyZero() && Collided.Packed.bChangedSinceLastStep == false);
+	UpdateSleepingChains(bInputsAtRest, InSimulationSettings);
+	Collided.Packed.bChangedSinceLastStep = false;
+
+	FAnimPhys_SolverParams& Params = OutParams;
+	Params.DeltaTime = InDeltaTime;
+	Params.LastDeltaTime = InLastDeltaTime;
+	Params.TargetFramerate = InTargetFramerate;
+	Params.DampingCoefficient = Simulated.bDampingEnabled ? (1.0f - InSetupSettings.Damping) * InDeltaTime : 0.0f;
+	Params.StiffnessCoefficient = Simulated.bStiffnessEnabled ? FMath::Clamp((1.0f - FMath::Pow(1.0f - InSetupSettings.Stiffness, InTargetFramerate * InDeltaTime)), 0.0f, 1.0f) : 0.0f;
+	Params.WorldDampingRotationCoefficient = (1.0f - InSetupSettings.WorldDampingRotation);
+	Params.GravityFactor = GravityFactor;
+	Params.WindFactor = WindFactor;
+	Params.WorldLocationVelocity = WorldLocationVelocity;
+	Params.WorldLocationSpeed = WorldLocationSpeed;
+	Params.ScaleDampingLerpSpeed = InSmoothingSettings.ScaleDampingLerpSpeed;
+	Params.ScaleDampingMultiplier = InSmoothingSettings.ScaleDampingMultiplier;
+
+	uint32 Features = 0;
+	Features |= Simulated.bDampingEnabled ? AnimPhysSolverFeatures::Damping : 0;
+	Features |= Simulated.bStiffnessEnabled ? AnimPhysSolverFeatures::Stiffness : 0;
+	Features |= Simulated.bGravityEnabled ? AnimPhysSolverFeatures::Gravity : 0;
+	Features |= Simulated.bWindEnabled ? AnimPhysSolverFeatures::Wind : 0;
+	Features |= Simulated.bWorldDampingEnabled ? AnimPhysSolverFeatures::WorldDamping : 0;
+	Features |= bWorldLocationMoved ? AnimPhysSolverFeatures::WorldLocationMoved : 0;
+	Features |= InSmoothingSettings.bScaleDampingWithExternalSpeed ? AnimPhysSolverFeatures::ScaleDampingWithExternalSpeed : 0;
+	Params.Features = (Features & Simulated.AllowedFeatures);
+
+	return true;
+}
+
+void FAnimPhys_WorkData::DispatchSimulateBonesKernel(const FAnimPhys_SolverParams& InParams)
+{
+	static const FSimulateBonesKernel* Kernels = GetSimulateBonesKernels(TMakeIntegerSequence<uint32, AnimPhysSolverFeatures::Num>());
+	(this->*Kernels[InParams.Features])(InParams);
+}
+
+template <uint32 InFeatures>
+void FAnimPhys_WorkData::SimulateBonesKernel(const FAnimPhys_SolverParams& InParams)
+{
+	constexpr bool bDamping = (InFeatures & AnimPhysSolverFeatures::Damping) != 0;
+	constexpr bool bStiffness = (InFeatures & AnimPhysSolverFeatures::Stiffness) != 0;
+	constexpr bool bGravity = (InFeatures & AnimPhysSolverFeatures::Gravity) != 0;
+	constexpr bool bWind = (InFeatures & AnimPhysSolverFeatures::Wind) != 0;
+	constexpr bool bWorldDamping = (InFeatures & AnimPhysSolverFeatures::WorldDamping) != 0;
+	constexpr bool bWorldLocationMoved = (InFeatures & AnimPhysSolverFeatures::WorldLocationMoved) != 0;
+	constexpr bool bScaleDampingWithExternalSpeed = (InFeatures & AnimPhysSolverFeatures::ScaleDampingWithExternalSpeed) != 0;
+
+	const int32 NumBones = Simulated.Num();
+	for (int32 BoneIndex = 0; BoneIndex < NumBones; ++BoneIndex)
+	{
+		const FAnimPhys_SimulatedBone_Topology& Bone = Simulated.Topology[BoneIndex];
+		FAnimPhys_SimulatedChain_WorkData& Chain = Simulated.Chains[Bone.ChainIndex];
+		if (Chain.bSleeping)
 		{
-			Bone.PrevLocation = Bone.ComponentSpaceTM.GetLocation();
-			Bone.ComponentSpaceTM = Bone.PoseComponentSpaceTM;
 			continue;
 		}
 
-		auto& ParentBone = Simulated.SimulatedBones[Bone.ParentIndex];
+		const int32 ParentIndex = Bone.ParentIndex;
+		if (ParentIndex == INDEX_NONE)
+		{
+			Simulated.PrevLocations[BoneIndex] = Simulated.Locations[BoneIndex];
+			Simulated.Locations[BoneIndex] = Simulated.PoseLocations[BoneIndex];
+			continue;
+		}
 
-		const FVector ParentBonePoseLocation = ParentBone.PoseComponentSpaceTM.GetLocation();
-		const FVector ParentBoneLocation = ParentBone.ComponentSpaceTM.GetLocation();
+		const FVector ParentBonePoseLocation = Simulated.PoseLocations[ParentIndex];
+		const FVector ParentBoneLocation = Simulated.Locations[ParentIndex];
 
-		const FVector BonePoseLocation = Bone.PoseComponentSpaceTM.GetLocation();
-		FVector BoneLocation = Bone.ComponentSpaceTM.GetLocation();
+		const FVector BonePoseLocation = Simulated.PoseLocations[BoneIndex];
+		FVector BoneLocation = Simulated.Locations[BoneIndex];
 
 		const FVector PoseDelta = BonePoseLocation - ParentBonePoseLocation;
 
-		if (Simulated.bDampingEnabled)
+		FVector& BonePrevLocation = Simulated.PrevLocations[BoneIndex];
+
+		if constexpr (bDamping)
 		{
-			FVector Velocity = (BoneLocation - Bone.PrevLocation) / InLastDeltaTime;
+			FVector& BoneVelocity = Simulated.Velocities[BoneIndex];
+			FVector Velocity = (BoneLocation - BonePrevLocation) / InParams.LastDeltaTime;
 
-			if (InSmoothingSettings.bScaleDampingWithExternalSpeed)
+			if constexpr (bScaleDampingWithExternalSpeed)
 			{
 				const float Speed = Velocity.Size();
-				if (Simulated.bWorldDampingEnabled && WorldLocationSpeed > 0.0f && Speed > 0.0f)
+				if (bWorldDamping && InParams.WorldLocationSpeed > 0.0f && Speed > 0.0f)
 				{
-					Velocity *= FMath::Max(1.0f, (WorldLocationSpeed / Speed)) * InSmoothingSettings.ScaleDampingMultiplier;
+					Velocity *= FMath::Max(1.0f, (InParams.WorldLocationSpeed / Speed)) * InParams.ScaleDampingMultiplier;
 				}
 
-				Bone.Velocity = FMath::Lerp(Bone.Velocity, Velocity, FMath::Min(1.0f, InDeltaTime * InSmoothingSettings.ScaleDampingLerpSpeed));
+				BoneVelocity = FMath::Lerp(BoneVelocity, Velocity, FMath::Min(1.0f, InParams.DeltaTime * InParams.ScaleDampingLerpSpeed));
 			}
 			else
 			{
-				Bone.Velocity = Velocity;
+				BoneVelocity = Velocity;
 			}
 
-			Bone.PrevLocation = BoneLocation;
-			BoneLocation += Bone.Velocity * DampingCoefficient;
+			BonePrevLocation = BoneLocation;
+			BoneLocation += BoneVelocity * InParams.DampingCoefficient;
 		}
 		else
 		{
-			Bone.PrevLocation = BoneLocation;
+			BonePrevLocation = BoneLocation;
 		}
 
 		FVector AccumulatedExternalDelta = FVector::ZeroVector;
@@ -368,47 +666,47 @@ void FAnimPhys_WorkData::SimulateBones(const FCompactPose& InPose, const float&
 		AccumulatedExternalDelta += Forced.Impulse;
 
 		// Wind
-		if (Simulated.bWindEnabled)
+		if constexpr (bWind)
 		{
-			const float WindCoefficient = FMath::FRandRange(0.0f, 2.0f) * InTargetFramerate * InDeltaTime;
-			AccumulatedExternalDelta += WindFactor * WindCoefficient;
+			const float WindCoefficient = Forced.WindNoise[BoneIndex] * InParams.TargetFramerate * InParams.DeltaTime;
+			AccumulatedExternalDelta += InParams.WindFactor * WindCoefficient;
 		}
 
 		// Follow Translation & Rotation
-		if (Simulated.bWorldDampingEnabled)
+		if constexpr (bWorldDamping)
 		{
-			AccumulatedExternalDelta += (WorldLocationVelocity * InDeltaTime);
+			AccumulatedExternalDelta += (InParams.WorldLocationVelocity * InParams.DeltaTime);
 
-			const FVector WorldRotationVelocity = (Moved.WorldRotationDelta.RotateVector(Bone.PrevLocation) - Bone.PrevLocation) / InLastDeltaTime * (1.0f - InSetupSettings.WorldDampingRotation);
-			AccumulatedExternalDelta += (WorldRotationVelocity * InDeltaTime);
+			const FVector WorldRotationVelocity = (Moved.WorldRotationDelta.RotateVector(BonePrevLocation) - BonePrevLocation) / InParams.LastDeltaTime * InParams.WorldDampingRotationCoefficient;
+			AccumulatedExternalDelta += (WorldRotationVelocity * InParams.DeltaTime);
 		}
 
 		// Gravity
-		if (Simulated.bGravityEnabled)
+		if constexpr (bGravity)
 		{
-			AccumulatedExternalDelta += GravityFactor;
+			AccumulatedExternalDelta += InParams.GravityFactor;
 		}
 
 		// Prevent overextension
-		if (bWorldLocationMoved)
+		if constexpr (bWorldLocationMoved)
 		{
-			const FVector PrevDelta = (Bone.PrevLocation - ParentBone.PrevLocation);
-			const FVector AdjustDelta = (PrevDelta + AccumulatedExternalDelta).GetSafeNormal() * Bone.BoneLengthToParent - PrevDelta;
+			const FVector PrevDelta = (BonePrevLocation - Simulated.PrevLocations[ParentIndex]);
+			const FVector AdjustDelta = (PrevDelta + AccumulatedExternalDelta).GetSafeNormal() * Simulated.BoneLengths[BoneIndex] - PrevDelta;
 			BoneLocation += AdjustDelta;
 		}
 		else
 		{
 			BoneLocation += AccumulatedExternalDelta;
-			AdjustBoneLength(Bone, BoneLocation);
+			AdjustBoneLength(BoneIndex, BoneLocation);
 		}
 
 		// Pull to Pose Location
-		if (Simulated.bStiffnessEnabled)
+		if constexpr (bStiffness)
 		{
 			const FVector BaseLocation = ParentBoneLocation + PoseDelta;
 			FVector PoseMoveDelta = (BaseLocation - BoneLocation);
 
-			PoseMoveDelta *= StiffnessCoefficient;
+			PoseMoveDelta *= InParams.StiffnessCoefficient;
 
 			BoneLocation += PoseMoveDelta;
 
@@ -419,191 +717,947 @@ void FAnimPhys_WorkData::SimulateBones(const FCompactPose& InPose, const float&
 			}
 		}
 
-		AdjustBoneLocation(BoneLocation);
-		AdjustBoneLength(Bone, BoneLocation);
-		AdjustBoneDirection(ParentBoneLocation, Bone.PoseComponentSpaceTM, ParentBone.PoseComponentSpaceTM, InSetupSettings, BoneLocation);
-
-		Bone.ComponentSpaceTM.SetLocation(BoneLocation);
-		Bone.ComponentSpaceTM.CopyRotationPart(Bone.PoseComponentSpaceTM);
-
-		if (ParentBone.NumChildren <= 1)
+		if (Collided.bSweptCollision)
 		{
-			const FVector InitialDir = PoseDelta.GetSafeNormal();
-			const FVector TargetDir = (BoneLocation - ParentBoneLocation).GetSafeNormal();
-
-			const FQuat DeltaRotation = FQuat::FindBetweenNormals(InitialDir, TargetDir);
-			ParentBone.ComponentSpaceTM.SetRotation(DeltaRotation * ParentBone.PoseComponentSpaceTM.GetRotation());
+			SweepBoneLocation(BoneIndex, Simulated.Locations[BoneIndex], BoneLocation);
 		}
+
+		AdjustBoneLocation(BoneIndex, BoneLocation);
+		AdjustBoneLength(BoneIndex, BoneLocation);
+		AdjustBoneDirection(ParentBoneLocation, BoneIndex, BoneLocation);
+
+		Chain.MaxStepDeltaSquared = FMath::Max(Chain.MaxStepDeltaSquared, FVector::DistSquared(BoneLocation, Simulated.Locations[BoneIndex]));
+		Simulated.Locations[BoneIndex] = BoneLocation;
 	}
 }
 
-void FAnimPhys_WorkData::ApplySimulateBones(FCompactPose& OutPose)
+int32 FAnimPhys_WorkData::RelaxConstraints(const int32 InMaxIterations, const float InTolerance)
 {
-	const FBoneContainer& RequiredBones = OutPose.GetBoneContainer();
+	// The solver pass already resolved every constraint once
+	int32 NumIterations = 1;
+
+	const float ToleranceSquared = FMath::Square(InTolerance);
+	const int32 NumBones = Simulated.Num();
 
-	for (const auto& Bone : Simulated.SimulatedBones)
+	while (NumIterations < InMaxIterations)
 	{
-		if (Bone.bValid == false)
+		++NumIterations;
+
+		float MaxCorrectionSquared = 0.0f;
+		for (int32 BoneIndex = 0; BoneIndex < NumBones; ++BoneIndex)
 		{
-			continue;
+			const int32 ParentIndex = Simulated.Topology[BoneIndex].ParentIndex;
+			if (ParentIndex == INDEX_NONE || Simulated.IsSleeping(BoneIndex))
+			{
+				continue;
+			}
+
+			FVector BoneLocation = Simulated.Locations[BoneIndex];
+
+			AdjustBoneLocation(BoneIndex, BoneLocation);
+			AdjustBoneLength(BoneIndex, BoneLocation);
+			AdjustBoneDirection(Simulated.Locations[ParentIndex], BoneIndex, BoneLocation);
+
+			MaxCorrectionSquared = FMath::Max(MaxCorrectionSquared, FVector::DistSquared(BoneLocation, Simulated.Locations[BoneIndex]));
+			Simulated.Locations[BoneIndex] = BoneLocation;
 		}
 
-		if (OutPose.IsValidIndex(Bone.CompactPoseBoneIndex) == false)
+		if (MaxCorrectionSquared <= ToleranceSquared)
 		{
-			continue;
+			break;
 		}
+	}
+
+	return NumIterations;
+}
+
+void FAnimPhys_WorkData::InterpolateLocations(const float InInterpolationAlpha)
+{
+	const int32 NumBones = Simulated.Num();
+	Simulated.InterpolatedLocations.SetNumUninitialized(NumBones);
 
-		FTransform TargetAtom = Bone.ComponentSpaceTM;
+	// Without a last step only the current one is re-anchored
+	const bool bHasLastStep = (InInterpolationAlpha != 1.0f && Simulated.LastStepLocations.Num() == NumBones);
 
-		if (Bone.ParentIndex == INDEX_NONE)
+	// Interpolate relative to the parent so the chains stay attached to the current pose of the roots
+	for (int32 BoneIndex = 0; BoneIndex < NumBones; ++BoneIndex)
+	{
+		const int32 ParentIndex = Simulated.Topology[BoneIndex].ParentIndex;
+		if (ParentIndex == INDEX_NONE)
 		{
-			FTransform ParentPoseComponentSpcaeTM;
-			const FMeshPoseBoneIndex ParentMeshPoseBoneIndex = RequiredBones.MakeMeshPoseIndex(RequiredBones.GetParentBoneIndex(Bone.CompactPoseBoneIndex));
-			if (TryGetPoseComponentSpaceTransform(ParentMeshPoseBoneIndex, ParentPoseComponentSpcaeTM))
-			{
-				TargetAtom.SetToRelativeTransform(ParentPoseComponentSpcaeTM);
-			}
+			Simulated.InterpolatedLocations[BoneIndex] = Simulated.PoseLocations[BoneIndex];
+			continue;
 		}
-		else
+
+		const FVector Delta = Simulated.Locations[BoneIndex] - Simulated.Locations[ParentIndex];
+		if (bHasLastStep == false)
 		{
-			const auto& ParentBone = Simulated.SimulatedBones[Bone.ParentIndex];
-			TargetAtom.SetToRelativeTransform(ParentBone.ComponentSpaceTM);
+			Simulated.InterpolatedLocations[BoneIndex] = Simulated.InterpolatedLocations[ParentIndex] + Delta;
+			continue;
 		}
 
-		OutPose[Bone.CompactPoseBoneIndex] = TargetAtom;
+		const FVector LastStepDelta = Simulated.LastStepLocations[BoneIndex] - Simulated.LastStepLocations[ParentIndex];
+		Simulated.InterpolatedLocations[BoneIndex] = Simulated.InterpolatedLocations[ParentIndex] + FMath::Lerp(LastStepDelta, Delta, InInterpolationAlpha);
 	}
 }
 
-void FAnimPhys_WorkData::AdjustBoneLocation(FVector& OutBoneLocation) const
+void FAnimPhys_WorkData::ApplySimulateBones(FCompactPose& OutPose, const float InInterpolationAlpha, const bool bInFollowPoseRoots)
 {
-	// AdjustBySphereCollision
-	for (const auto& CollidedSphere : Collided.Spheres)
+	const int32 NumBones = Simulated.Num();
+
+	// Beyond 1 extrapolates past the last step. The locations of the last step are in component space,
+	// so evaluations that did not step would leave the roots where the pose was back then
+	const bool bInterpolate = bInFollowPoseRoots || (InInterpolationAlpha != 1.0f && Simulated.LastStepLocations.Num() == NumBones);
+	if (bInterpolate)
+	{
+		InterpolateLocations(InInterpolationAlpha);
+	}
+
+	const TArray<FVector>& OutputLocations = bInterpolate ? Simulated.InterpolatedLocations : Simulated.Locations;
+
+	// Rotations are not part of the solver state, rebuild them from the simulated locations
+	Simulated.Rotations = Simulated.PoseRotations;
+
+	for (int32 BoneIndex = 0; BoneIndex < NumBones; ++BoneIndex)
 	{
-		if (CollidedSphere.bValid == false)
+		const int32 ParentIndex = Simulated.Topology[BoneIndex].ParentIndex;
+		if (ParentIndex == INDEX_NONE || Simulated.Topology[ParentIndex].NumChildren > 1)
 		{
 			continue;
 		}
 
-		if ((OutBoneLocation - CollidedSphere.Center).SizeSquared() > CollidedSphere.LimitDistanceSquared)
+		if (Simulated.Chains[Simulated.Topology[BoneIndex].ChainIndex].bHasCachedLocalTransforms)
 		{
 			continue;
 		}
 
-		OutBoneLocation = CollidedSphere.Center + (OutBoneLocation - CollidedSphere.Center).GetSafeNormal() * CollidedSphere.LimitDistance;
+		const FVector InitialDir = (Simulated.PoseLocations[BoneIndex] - Simulated.PoseLocations[ParentIndex]).GetSafeNormal();
+		const FVector TargetDir = (OutputLocations[BoneIndex] - OutputLocations[ParentIndex]).GetSafeNormal();
+
+		const FQuat DeltaRotation = FQuat::FindBetweenNormals(InitialDir, TargetDir);
+		Simulated.Rotations[ParentIndex] = DeltaRotation * Simulated.PoseRotations[ParentIndex];
 	}
 
-	// AdjustByCapsuleCollision
-	for (const auto& CollidedCapsule : Collided.Capsules)
+	// Decimated bones turn with the segment between the simulated bones around them, so they stay along the simulated polyline.
+	// Their rotations blend into the turn of the next segment down the chain
+	const int32 NumDecimatedBones = Simulated.DecimatedTopology.Num();
+	for (int32 DecimatedIndex = 0; DecimatedIndex < NumDecimatedBones; ++DecimatedIndex)
 	{
-		if (CollidedCapsule.bValid == false)
+		const FAnimPhys_DecimatedBone_Topology& Bone = Simulated.DecimatedTopology[DecimatedIndex];
+		const int32 ParentIndex = Bone.SimulatedParentIndex;
+		if (Simulated.ValidDecimatedBones[DecimatedIndex] == false || Simulated.Chains[Simulated.Topology[ParentIndex].ChainIndex].bHasCachedLocalTransforms)
 		{
 			continue;
 		}
 
-		const FVector ClosestPoint = FMath::ClosestPointOnSegment(OutBoneLocation, CollidedCapsule.SegmentStart, CollidedCapsule.SegmentEnd);
+		FQuat SegmentRotation = Simulated.Rotations[ParentIndex] * Simulated.PoseRotations[ParentIndex].Inverse();
+		FQuat DeltaRotation = SegmentRotation;
 
-		if ((OutBoneLocation - ClosestPoint).SizeSquared() > CollidedCapsule.LimitDistanceSquared)
+		const int32 ChildIndex = Bone.SimulatedChildIndex;
+		if (ChildIndex != INDEX_NONE && Simulated.ValidBones[ChildIndex])
 		{
-			continue;
+			const FVector InitialDir = (Simulated.PoseLocations[ChildIndex] - Simulated.PoseLocations[ParentIndex]).GetSafeNormal();
+			const FVector TargetDir = (OutputLocations[ChildIndex] - OutputLocations[ParentIndex]).GetSafeNormal();
+			SegmentRotation = FQuat::FindBetweenNormals(InitialDir, TargetDir);
+
+			const FQuat ChildSegmentRotation = (Simulated.Topology[ChildIndex].NumChildren == 1) ? (Simulated.Rotations[ChildIndex] * Simulated.PoseRotations[ChildIndex].Inverse()) : SegmentRotation;
+			DeltaRotation = FQuat::Slerp(SegmentRotation, ChildSegmentRotation, Bone.SegmentAlpha);
 		}
 
-		OutBoneLocation = ClosestPoint + (OutBoneLocation - ClosestPoint).GetSafeNormal() * CollidedCapsule.LimitDistance;
+		const FTransform& PoseComponentSpaceTM = Simulated.DecimatedPoseTransforms[DecimatedIndex];
+
+		Simulated.DecimatedTransforms[DecimatedIndex] = FTransform(
+			DeltaRotation * PoseComponentSpaceTM.GetRotation(),
+			OutputLocations[ParentIndex] + SegmentRotation.RotateVector(PoseComponentSpaceTM.GetLocation() - Simulated.PoseLocations[ParentIndex]),
+			PoseComponentSpaceTM.GetScale3D());
 	}
 
-	// AdjustByPlanerCollision
-	for (const auto& CollidedPlanar : Collided.Planars)
+	for (int32 BoneIndex = 0; BoneIndex < NumBones; ++BoneIndex)
 	{
-		if (CollidedPlanar.bValid == false)
+		if (Simulated.ValidBones[BoneIndex] == false)
 		{
 			continue;
 		}
 
-		const FVector PointOnPlane = FVector::PointPlaneProject(OutBoneLocation, CollidedPlanar.Plane);
-		const FVector Direction = (OutBoneLocation - PointOnPlane);
-		const float DistSquared = Direction.SizeSquared();
-
-		bool bIntersects = (DistSquared < CollidedPlanar.LimitDistanceSquared);
-		if (bIntersects == false)
+		const FAnimPhys_SimulatedBone_Topology& Bone = Simulated.Topology[BoneIndex];
+		const FCompactPoseBoneIndex CompactPoseBoneIndex = Simulated.CompactPoseBoneIndexes[BoneIndex];
+		if (OutPose.IsValidIndex(CompactPoseBoneIndex) == false)
 		{
-			bIntersects = (FVector::DotProduct(Direction.GetSafeNormal(), CollidedPlanar.Plane.GetNormal()) < 0.0f);
+			continue;
 		}
 
-		if (bIntersects == false)
+		if (Simulated.Chains[Bone.ChainIndex].bHasCachedLocalTransforms)
 		{
+			OutPose[CompactPoseBoneIndex] = Simulated.LocalTransforms[BoneIndex];
 			continue;
 		}
 
-		OutBoneLocation = PointOnPlane + CollidedPlanar.Plane.GetNormal() * CollidedPlanar.LimitDistance;
+		FTransform TargetAtom(Simulated.Rotations[BoneIndex], OutputLocations[BoneIndex], Simulated.PoseScales[BoneIndex]);
+
+		if (Bone.ParentIndex == INDEX_NONE)
+		{
+			FTransform ParentPoseComponentSpcaeTM;
+			if (TryGetPoseComponentSpaceTransform(Simulated.Chains[Bone.ChainIndex].ParentCachedSlot, ParentPoseComponentSpcaeTM))
+			{
+				TargetAtom.SetToRelativeTransform(ParentPoseComponentSpcaeTM);
+			}
+		}
+		else if (Bone.DecimatedParentIndex != INDEX_NONE)
+		{
+			TargetAtom.SetToRelativeTransform(Simulated.DecimatedTransforms[Bone.DecimatedParentIndex]);
+		}
+		else
+		{
+			const FTransform ParentComponentSpaceTM(Simulated.Rotations[Bone.ParentIndex], OutputLocations[Bone.ParentIndex], Simulated.PoseScales[Bone.ParentIndex]);
+			TargetAtom.SetToRelativeTransform(ParentComponentSpaceTM);
+		}
+
+		OutPose[CompactPoseBoneIndex] = TargetAtom;
+		Simulated.LocalTransforms[BoneIndex] = TargetAtom;
 	}
 
-	// AdjustByFloorCollision
-	if (Collided.Floor.bValid)
+	for (int32 DecimatedIndex = 0; DecimatedIndex < NumDecimatedBones; ++DecimatedIndex)
 	{
-		const FVector PointOnPlane = FVector::PointPlaneProject(OutBoneLocation, Collided.Floor.Plane);
-		const FVector Direction = (OutBoneLocation - PointOnPlane);
-		const float DistSquared = Direction.SizeSquared();
+		const FCompactPoseBoneIndex CompactPoseBoneIndex = Simulated.DecimatedCompactPoseBoneIndexes[DecimatedIndex];
+		if (Simulated.ValidDecimatedBones[DecimatedIndex] == false || OutPose.IsValidIndex(CompactPoseBoneIndex) == false)
+		{
+			continue;
+		}
 
-		bool bIntersects = (DistSquared < Collided.Floor.LimitDistanceSquared);
-		if (bIntersects == false)
+		const FAnimPhys_DecimatedBone_Topology& Bone = Simulated.DecimatedTopology[DecimatedIndex];
+		if (Simulated.Chains[Simulated.Topology[Bone.SimulatedParentIndex].ChainIndex].bHasCachedLocalTransforms)
 		{
-			bIntersects = (FVector::DotProduct(Direction.GetSafeNormal(), Collided.Floor.Plane.GetNormal()) < 0.0f);
+			OutPose[CompactPoseBoneIndex] = Simulated.DecimatedLocalTransforms[DecimatedIndex];
+			continue;
 		}
 
-		if (bIntersects)
+		FTransform TargetAtom = Simulated.DecimatedTransforms[DecimatedIndex];
+
+		if (Bone.DecimatedParentIndex != INDEX_NONE)
 		{
-			OutBoneLocation = PointOnPlane + Collided.Floor.Plane.GetNormal() * Collided.Floor.LimitDistance;
+			TargetAtom.SetToRelativeTransform(Simulated.DecimatedTransforms[Bone.DecimatedParentIndex]);
+		}
+		else
+		{
+			const FTransform ParentComponentSpaceTM(Simulated.Rotations[Bone.SimulatedParentIndex], OutputLocations[Bone.SimulatedParentIndex], Simulated.PoseScales[Bone.SimulatedParentIndex]);
+			TargetAtom.SetToRelativeTransform(ParentComponentSpaceTM);
 		}
+
+		OutPose[CompactPoseBoneIndex] = TargetAtom;
+		Simulated.DecimatedLocalTransforms[DecimatedIndex] = TargetAtom;
 	}
 
+	for (auto& Chain : Simulated.Chains)
+	{
+		Chain.bHasCachedLocalTransforms = Chain.bSleeping;
+	}
 }
 
-void FAnimPhys_WorkData::AdjustBoneLength(const FAnimPhys_SimulatedBone_WorkData& InBone, FVector& OutBoneLocation) const
+void FAnimPhys_Cached_WorkData::Empty()
 {
-	const FAnimPhys_SimulatedBone_WorkData& ParentBone = Simulated.SimulatedBones[InBone.ParentIndex];
-	const FVector ParentBoneLocation = ParentBone.ComponentSpaceTM.GetLocation();
+	ComponentSpaceTMs.Empty();
+	AttachedComponentSpaceTMs.Empty();
+	SlotTable.Reset();
+	AttachedSlotTable.Reset();
+
+	NumComponentSpaceTransforms = 0;
+	NumAttachedComponentSpaceTransforms = 0;
+	AttachedMesh = NAME_None;
+	bHasCachedTransforms = false;
 
-	OutBoneLocation = (OutBoneLocation - ParentBoneLocation).GetSafeNormal() * InBone.BoneLengthToParent + ParentBoneLocation;
+	++Generation;
 }
 
-void FAnimPhys_WorkData::AdjustBoneDirection(const FVector& InParentBoneLocation, const FTransform& InPoseComponentSpaceTM, const FTransform& InParentPoseComponentSpaceTM, const FAnimPhysSetupSettings& InSetupSettings, FVector& OutBoneLocation) const
+void FAnimPhys_Cached_WorkData::SetBoneIndexes(const TArray<int32>& InBoneIndexes, const int32 InNumBones)
 {
-	bool bAdjusted = false;
-	FVector BoneDir = FVector::ZeroVector;
+	SlotTable = AnimPhysCompiledSetup::FindOrCompileCacheSlots(InBoneIndexes, InNumBones);
+	ComponentSpaceTMs.Init(FTransform::Identity, SlotTable->Num());
+	NumComponentSpaceTransforms = InNumBones;
+
+	++Generation;
+}
+
+void FAnimPhys_Cached_WorkData::SetAttachedBoneIndexes(const TArray<int32>& InBoneIndexes, const int32 InNumBones)
+{
+	AttachedSlotTable = AnimPhysCompiledSetup::FindOrCompileCacheSlots(InBoneIndexes, InNumBones);
+	AttachedComponentSpaceTMs.Init(FTransform::Identity, AttachedSlotTable->Num());
+	NumAttachedComponentSpaceTransforms = InNumBones;
+
+	++Generation;
+}
+
+void FAnimPhys_Forced_WorkData::GenerateWindNoise(int32 InNum)
+{
+	// Counter based, so every value only depends on the seed, the bone and the step.
+	// Four bones are hashed at once and mapped to [0, 2).
+	const int32 NumPadded = Align(InNum, 4);
+	WindNoise.SetNumUninitialized(NumPadded);
+
+	const uint32 Key = WindNoiseSeed ^ (WindNoiseStep * 0x85ebca6bu);
+	++WindNoiseStep;
+
+	const VectorRegister4Int KeyVec = VectorIntSet1(static_cast<int32>(Key));
+	const VectorRegister4Int BoneStride = MakeVectorRegisterInt(0, 1, 2, 3);
+	const VectorRegister4Int FirstMultiplier = VectorIntSet1(static_cast<int32>(0x7feb352du));
+	const VectorRegister4Int SecondMultiplier = VectorIntSet1(static_cast<int32>(0x846ca68bu));
+	const VectorRegister4Int GoldenRatio = VectorIntSet1(static_cast<int32>(0x9e3779b9u));
+	const VectorRegister4Float ToUnitRange = VectorSetFloat1(2.0f / 16777216.0f);
+
+	for (int32 BoneIndex = 0; BoneIndex < NumPadded; BoneIndex += 4)
+	{
+		VectorRegister4Int Hash = VectorIntAdd(VectorIntSet1(BoneIndex), BoneStride);
+		Hash = VectorIntXor(VectorIntMultiply(Hash, GoldenRatio), KeyVec);
+
+		Hash = VectorIntXor(Hash, VectorShiftRightImmLogical(Hash, 16));
+		Hash = VectorIntMultiply(Hash, FirstMultiplier);
+		Hash = VectorIntXor(Hash, VectorShiftRightImmLogical(Hash, 15));
+		Hash = VectorIntMultiply(Hash, SecondMultiplier);
+		Hash = VectorIntXor(Hash, VectorShiftRightImmLogical(Hash, 16));
+
+		// Top 24 bits fit the float mantissa exactly
+		const VectorRegister4Float Noise = VectorMultiply(VectorIntToFloat(VectorShiftRightImmLogical(Hash, 8)), ToUnitRange);
+		VectorStore(Noise, &WindNoise[BoneIndex]);
+	}
+}
+
+void FAnimPhys_AxisAngleLimit::Set(const FVector2D& InLimitAngle)
+{
+	bEnabled = (InLimitAngle.IsZero() == false);
+
+	Min = static_cast<float>(InLimitAngle.GetMin());
+	Max = static_cast<float>(InLimitAngle.GetMax());
+
+	FMath::SinCos(&MinSin, &MinCos, FMath::DegreesToRadians(Min));
+	FMath::SinCos(&MaxSin, &MaxCos, FMath::DegreesToRadians(Max));
+}
+
+uint32 FAnimPhysLODSettings::GetColliderTypes(const int32 InLOD) const
+{
+	if (IsReached(NoCollisionLOD, InLOD))
+	{
+		return 0;
+	}
+
+	if (IsReached(NoPhysBodyCollisionLOD, InLOD))
+	{
+		return AnimPhysColliderTypes::All & ~static_cast<uint32>(AnimPhysColliderTypes::PhysBody);
+	}
+
+	return AnimPhysColliderTypes::All;
+}
+
+uint32 FAnimPhysLODSettings::GetSolverFeatures(const int32 InLOD) const
+{
+	if (IsReached(StiffnessOnlyLOD, InLOD))
+	{
+		return AnimPhysSolverFeatures::Stiffness;
+	}
+
+	return AnimPhysSolverFeatures::Num - 1;
+}
+
+void FAnimPhys_AngleLimits::Set(const FAnimPhysSetupSettings& InSetupSettings, const bool bInAllowed)
+{
+	bAllowed = bInAllowed;
+
+	bConeEnabled = (bAllowed && InSetupSettings.LimitAngle > 0.0f);
+	FMath::SinCos(&ConeSin, &ConeCos, FMath::DegreesToRadians(FMath::Min(InSetupSettings.LimitAngle, 180.0f)));
+
+	AxisX.Set(InSetupSettings.LimitAngleX);
+	AxisY.Set(InSetupSettings.LimitAngleY);
+	AxisZ.Set(InSetupSettings.LimitAngleZ);
+	bAxisEnabled = (bAllowed && (AxisX.bEnabled || AxisY.bEnabled || AxisZ.bEnabled));
+}
+
+void FAnimPhys_PackedColliders::Reset()
+{
+	Spheres.Reset();
+	Capsules.Reset();
+	Planars.Reset();
+
+	NumSpheres = 0;
+	NumCapsules = 0;
+	NumPlanars = 0;
+}
 
-	if (InSetupSettings.LimitAngle > 0.0f)
+void FAnimPhys_PackedColliders::AddSphere(const FAnimPhys_CollidedSphere_WorkData& InSphere)
+{
+	const int32 Lane = (NumSpheres % 4);
+	if (Lane == 0)
 	{
-		BoneDir = (OutBoneLocation - InParentBoneLocation).GetSafeNormal();
-		const FVector PoseDir = (InPoseComponentSpaceTM.GetLocation() - InParentPoseComponentSpaceTM.GetLocation()).GetSafeNormal();
-		const FVector Axis = FVector::CrossProduct(PoseDir, BoneDir);
-		float Angle = FMath::RadiansToDegrees(FMath::Atan2(Axis.Size(), FVector::DotProduct(PoseDir, BoneDir)));
-		const float AngleOverLimit = Angle - InSetupSettings.LimitAngle;
-		if (AngleOverLimit > 0.0f)
+		FAnimPhys_PackedSpheres& NewPack = Spheres.AddZeroed_GetRef();
+		for (int32 Index = 0; Index < 4; ++Index)
 		{
-			BoneDir = BoneDir.RotateAngleAxis(-AngleOverLimit, Axis);
-			bAdjusted = true;
+			// Never collides, dist squared is always greater than a negative limit
+			NewPack.CenterX[Index] = NewPack.CenterY[Index] = NewPack.CenterZ[Index] = 0.0f;
+			NewPack.LimitDistance[Index] = 0.0f;
+			NewPack.LimitDistanceSquared[Index] = -1.0f;
+		}
+	}
+
+	FAnimPhys_PackedSpheres& Pack = Spheres.Last();
+	Pack.CenterX[Lane] = InSphere.Center.X;
+	Pack.CenterY[Lane] = InSphere.Center.Y;
+	Pack.CenterZ[Lane] = InSphere.Center.Z;
+	Pack.LimitDistance[Lane] = InSphere.Definition->LimitDistance;
+	Pack.LimitDistanceSquared[Lane] = InSphere.Definition->LimitDistanceSquared;
+
+	++NumSpheres;
+}
+
+void FAnimPhys_PackedColliders::AddCapsule(const FAnimPhys_CollidedCapsule_WorkData& InCapsule)
+{
+	const int32 Lane = (NumCapsules % 4);
+	if (Lane == 0)
+	{
+		FAnimPhys_PackedCapsules& NewPack = Capsules.AddZeroed_GetRef();
+		for (int32 Index = 0; Index < 4; ++Index)
+		{
+			NewPack.StartX[Index] = NewPack.StartY[Index] = NewPack.StartZ[Index] = 0.0f;
+			NewPack.AxisX[Index] = NewPack.AxisY[Index] = NewPack.AxisZ[Index] = 0.0f;
+			NewPack.InvAxisSizeSquared[Index] = 0.0f;
+			NewPack.LimitDistance[Index] = 0.0f;
+			NewPack.LimitDistanceSquared[Index] = -1.0f;
+		}
+	}
+
+	const FVector Axis = (InCapsule.SegmentEnd - InCapsule.SegmentStart);
+	const float AxisSizeSquared = Axis.SizeSquared();
+
+	FAnimPhys_PackedCapsules& Pack = Capsules.Last();
+	Pack.StartX[Lane] = InCapsule.SegmentStart.X;
+	Pack.StartY[Lane] = InCapsule.SegmentStart.Y;
+	Pack.StartZ[Lane] = InCapsule.SegmentStart.Z;
+	Pack.AxisX[Lane] = Axis.X;
+	Pack.AxisY[Lane] = Axis.Y;
+	Pack.AxisZ[Lane] = Axis.Z;
+	Pack.InvAxisSizeSquared[Lane] = (AxisSizeSquared > UE_SMALL_NUMBER) ? (1.0f / AxisSizeSquared) : 0.0f;
+	Pack.LimitDistance[Lane] = InCapsule.Definition->LimitDistance;
+	Pack.LimitDistanceSquared[Lane] = InCapsule.Definition->LimitDistanceSquared;
+
+	++NumCapsules;
+}
+
+void FAnimPhys_PackedColliders::AddPlanar(const FAnimPhys_CollidedPlanar_WorkData& InPlanar)
+{
+	const int32 Lane = (NumPlanars % 4);
+	if (Lane == 0)
+	{
+		FAnimPhys_PackedPlanars& NewPack = Planars.AddZeroed_GetRef();
+		for (int32 Index = 0; Index < 4; ++Index)
+		{
+			// Never collides, the signed distance is always MAX_flt
+			NewPack.NormalX[Index] = NewPack.NormalY[Index] = NewPack.NormalZ[Index] = 0.0f;
+			NewPack.W[Index] = -MAX_flt;
+			NewPack.LimitDistance[Index] = 0.0f;
+		}
+	}
+
+	FAnimPhys_PackedPlanars& Pack = Planars.Last();
+	Pack.NormalX[Lane] = InPlanar.Plane.X;
+	Pack.NormalY[Lane] = InPlanar.Plane.Y;
+	Pack.NormalZ[Lane] = InPlanar.Plane.Z;
+	Pack.W[Lane] = InPlanar.Plane.W;
+	Pack.LimitDistance[Lane] = InPlanar.Definition->LimitDistance;
+
+	++NumPlanars;
+}
+
+void FAnimPhys_WorkData::PackColliders(const uint32 InColliderTypes)
+{
+	FAnimPhys_PackedColliders& Packed = Collided.Packed;
+	Packed.Reset();
+
+	if (InColliderTypes & AnimPhysColliderTypes::Sphere)
+	{
+		for (const auto& CollidedSphere : Collided.Spheres)
+		{
+			if (CollidedSphere.bValid)
+			{
+				Packed.AddSphere(CollidedSphere);
+			}
+		}
+	}
+
+	if (InColliderTypes & AnimPhysColliderTypes::Capsule)
+	{
+		for (const auto& CollidedCapsule : Collided.Capsules)
+		{
+			if (CollidedCapsule.bValid)
+			{
+				Packed.AddCapsule(CollidedCapsule);
+			}
+		}
+	}
+
+	if (InColliderTypes & AnimPhysColliderTypes::Planar)
+	{
+		for (const auto& CollidedPlanar : Collided.Planars)
+		{
+			if (CollidedPlanar.bValid)
+			{
+				Packed.AddPlanar(CollidedPlanar);
+			}
+		}
+	}
+
+	if (InColliderTypes & AnimPhysColliderTypes::PhysBody)
+	{
+		for (const auto& CollidedSphere : Collided.PhysBodySpheres)
+		{
+			if (CollidedSphere.bValid)
+			{
+				Packed.AddSphere(CollidedSphere);
+			}
+		}
+
+		for (const auto& CollidedCapsule : Collided.PhysBodyCapsules)
+		{
+			if (CollidedCapsule.bValid)
+			{
+				Packed.AddCapsule(CollidedCapsule);
+			}
+		}
+	}
+
+	// Sleeping chains are woken as soon as any collider moves
+	uint32 Hash = FCrc::MemCrc32(Packed.Spheres.GetData(), Packed.Spheres.Num() * sizeof(FAnimPhys_PackedSpheres));
+	Hash = FCrc::MemCrc32(Packed.Capsules.GetData(), Packed.Capsules.Num() * sizeof(FAnimPhys_PackedCapsules), Hash);
+	Hash = FCrc::MemCrc32(Packed.Planars.GetData(), Packed.Planars.Num() * sizeof(FAnimPhys_PackedPlanars), Hash);
+	if (Collided.Floor.bValid)
+	{
+		Hash = FCrc::MemCrc32(&Collided.Floor.Plane, sizeof(FPlane), Hash);
+	}
+
+	Packed.bChangedSinceLastStep |= (Hash != Packed.Hash);
+	Packed.Hash = Hash;
+
+	PackChainColliders(InColliderTypes);
+}
+
+void FAnimPhys_WorkData::PackChainColliders(const uint32 InColliderTypes)
+{
+	// A chain can not get further from its root than the sum of its bone lengths
+	for (auto& Chain : Simulated.Chains)
+	{
+		Chain.BoundsCenter = Simulated.PoseLocations[Chain.RootIndex];
+		Chain.BoundsRadius = 0.0f;
+	}
+
+	for (int32 BoneIndex = 0; BoneIndex < Simulated.Num(); ++BoneIndex)
+	{
+		const FAnimPhys_SimulatedBone_Topology& Bone = Simulated.Topology[BoneIndex];
+		if (Bone.ParentIndex != INDEX_NONE)
+		{
+			Simulated.Chains[Bone.ChainIndex].BoundsRadius += Simulated.BoneLengths[BoneIndex];
+		}
+	}
+
+	Collided.ChainPacked.SetNum(Simulated.Chains.Num());
+
+	for (int32 ChainIndex = 0; ChainIndex < Simulated.Chains.Num(); ++ChainIndex)
+	{
+		FAnimPhys_SimulatedChain_WorkData& Chain = Simulated.Chains[ChainIndex];
+		FAnimPhys_PackedColliders& ChainPacked = Collided.ChainPacked[ChainIndex];
+		ChainPacked.Reset();
+
+		const FVector& Center = Chain.BoundsCenter;
+		const float Radius = Chain.BoundsRadius;
+
+		auto PackSpheres = [&ChainPacked, &Center, Radius](const TArray<FAnimPhys_CollidedSphere_WorkData>& InSpheres)
+		{
+			for (const auto& CollidedSphere : InSpheres)
+			{
+				if (CollidedSphere.bValid && FVector::DistSquared(CollidedSphere.Center, Center) <= FMath::Square(CollidedSphere.Definition->LimitDistance + Radius))
+				{
+					ChainPacked.AddSphere(CollidedSphere);
+				}
+			}
+		};
+
+		auto PackCapsules = [&ChainPacked, &Center, Radius](const TArray<FAnimPhys_CollidedCapsule_WorkData>& InCapsules)
+		{
+			for (const auto& CollidedCapsule : InCapsules)
+			{
+				if (CollidedCapsule.bValid && FMath::PointDistToSegmentSquared(Center, CollidedCapsule.SegmentStart, CollidedCapsule.SegmentEnd) <= FMath::Square(CollidedCapsule.Definition->LimitDistance + Radius))
+				{
+					ChainPacked.AddCapsule(CollidedCapsule);
+				}
+			}
+		};
+
+		if (InColliderTypes & AnimPhysColliderTypes::Sphere)
+		{
+			PackSpheres(Collided.Spheres);
+		}
+
+		if (InColliderTypes & AnimPhysColliderTypes::Capsule)
+		{
+			PackCapsules(Collided.Capsules);
+		}
+
+		if (InColliderTypes & AnimPhysColliderTypes::Planar)
+		{
+			for (const auto& CollidedPlanar : Collided.Planars)
+			{
+				if (CollidedPlanar.bValid && CollidedPlanar.Plane.PlaneDot(Center) - Radius < CollidedPlanar.Definition->LimitDistance)
+				{
+					ChainPacked.AddPlanar(CollidedPlanar);
+				}
+			}
 		}
+
+		if (InColliderTypes & AnimPhysColliderTypes::PhysBody)
+		{
+			PackSpheres(Collided.PhysBodySpheres);
+			PackCapsules(Collided.PhysBodyCapsules);
+		}
+
+		const FAnimPhys_PackedColliders& Packed = Collided.Packed;
+		Chain.bOverlapsAllColliders = (ChainPacked.NumSpheres == Packed.NumSpheres && ChainPacked.NumCapsules == Packed.NumCapsules && ChainPacked.NumPlanars == Packed.NumPlanars);
+	}
+}
+
+const FAnimPhys_PackedColliders& FAnimPhys_WorkData::GetPackedColliders(const int32 InBoneIndex, const FVector& InBoneLocation) const
+{
+	// Before the length constraint a bone can be outside of its chain bounds, so it gets all colliders
+	const int32 ChainIndex = Simulated.Topology[InBoneIndex].ChainIndex;
+	const FAnimPhys_SimulatedChain_WorkData& Chain = Simulated.Chains[ChainIndex];
+	if (Chain.bOverlapsAllColliders || Collided.ChainPacked.IsValidIndex(ChainIndex) == false)
+	{
+		return Collided.Packed;
 	}
-	else if (InSetupSettings.LimitAngleX.IsZero() == false || InSetupSettings.LimitAngleY.IsZero() == false || InSetupSettings.LimitAngleZ.IsZero() == false)
+
+	if (FVector::DistSquared(InBoneLocation, Chain.BoundsCenter) > FMath::Square(Chain.BoundsRadius))
 	{
-		BoneDir = (OutBoneLocation - InParentBoneLocation).GetSafeNormal();
-		const FVector PoseDir = (InPoseComponentSpaceTM.GetLocation() - InParentPoseComponentSpaceTM.GetLocation()).GetSafeNormal();
+		return Collided.Packed;
+	}
 
-		FMatrix RotMatrix = FRotationMatrix(InPoseComponentSpaceTM.GetRotation().Rotator());
+	return Collided.ChainPacked[ChainIndex];
+}
 
-		FVector AxisX, AxisY, AxisZ;
-		RotMatrix.GetUnitAxes(AxisX, AxisY, AxisZ);
+namespace AnimPhysSweep
+{
+	// Earliest hit of Start + Dir * Time against a sphere, or -1 when the ray misses or starts inside
+	static float RaySphere(const FVector& InStart, const FVector& InDir, const FVector& InCenter, const float InRadius)
+	{
+		const FVector StartToCenter = InStart - InCenter;
+		const float C = FVector::DotProduct(StartToCenter, StartToCenter) - InRadius * InRadius;
+		if (C <= 0.0f)
+		{
+			return -1.0f;
+		}
 
-		if (TryAdjustBoneDirectionByAngleLimitAxis(AxisX, PoseDir, InSetupSettings.LimitAngleX, BoneDir))
+		const float B = FVector::DotProduct(StartToCenter, InDir);
+		const float H = B * B - C;
+		if (H < 0.0f)
+		{
+			return -1.0f;
+		}
+
+		return -B - FMath::Sqrt(H);
+	}
+
+	// Same for a capsule, InDir has to be normalized
+	static float RayCapsule(const FVector& InStart, const FVector& InDir, const FVector& InSegmentStart, const FVector& InAxis, const float InRadius)
+	{
+		const FVector StartToSegment = InStart - InSegmentStart;
+
+		const float AxisSizeSquared = FVector::DotProduct(InAxis, InAxis);
+		const float AxisDotDir = FVector::DotProduct(InAxis, InDir);
+		const float AxisDotStart = FVector::DotProduct(InAxis, StartToSegment);
+
+		if (FMath::PointDistToSegmentSquared(InStart, InSegmentStart, InSegmentStart + InAxis) <= InRadius * InRadius)
+		{
+			return -1.0f;
+		}
+
+		const float A = AxisSizeSquared - AxisDotDir * AxisDotDir;
+		if (A > UE_KINDA_SMALL_NUMBER)
+		{
+			const float B = AxisSizeSquared * FVector::DotProduct(InDir, StartToSegment) - AxisDotStart * AxisDotDir;
+			const float C = AxisSizeSquared * FVector::DotProduct(StartToSegment, StartToSegment) - AxisDotStart * AxisDotStart - InRadius * InRadius * AxisSizeSquared;
+			const float H = B * B - A * C;
+			if (H < 0.0f)
+			{
+				return -1.0f;
+			}
+
+			// Hit on the cylinder body
+			const float Time = (-B - FMath::Sqrt(H)) / A;
+			const float AlongAxis = AxisDotStart + Time * AxisDotDir;
+			if (AlongAxis > 0.0f && AlongAxis < AxisSizeSquared)
+			{
+				return Time;
+			}
+		}
+
+		// Otherwise the caps
+		const float StartCapTime = RaySphere(InStart, InDir, InSegmentStart, InRadius);
+		const float EndCapTime = RaySphere(InStart, InDir, InSegmentStart + InAxis, InRadius);
+		if (StartCapTime < 0.0f || (EndCapTime >= 0.0f && EndCapTime < StartCapTime))
+		{
+			return EndCapTime;
+		}
+
+		return StartCapTime;
+	}
+}
+
+void FAnimPhys_WorkData::SweepBoneLocation(const int32 InBoneIndex, const FVector& InStartLocation, FVector& OutBoneLocation) const
+{
+	const FVector Delta = OutBoneLocation - InStartLocation;
+	const float Distance = Delta.Size();
+	if (Distance <= UE_KINDA_SMALL_NUMBER)
+	{
+		return;
+	}
+
+	// The chain set only covers the sweep when both ends are inside the chain bounds
+	const FAnimPhys_PackedColliders& StartPacked = GetPackedColliders(InBoneIndex, InStartLocation);
+	const FAnimPhys_PackedColliders& Packed = (&StartPacked == &GetPackedColliders(InBoneIndex, OutBoneLocation)) ? StartPacked : Collided.Packed;
+
+	const FVector Dir = Delta / Distance;
+	float HitDistance = Distance;
+	FVector HitNormal = FVector::ZeroVector;
+
+	for (int32 Index = 0; Index < Packed.NumSpheres; ++Index)
+	{
+		const FAnimPhys_PackedSpheres& Pack = Packed.Spheres[Index / 4];
+		const int32 Lane = (Index % 4);
+
+		const FVector Center(Pack.CenterX[Lane], Pack.CenterY[Lane], Pack.CenterZ[Lane]);
+		const float Time = AnimPhysSweep::RaySphere(InStartLocation, Dir, Center, Pack.LimitDistance[Lane]);
+		if (Time >= 0.0f && Time < HitDistance)
+		{
+			HitDistance = Time;
+			HitNormal = (InStartLocation + Dir * Time - Center).GetSafeNormal();
+		}
+	}
+
+	for (int32 Index = 0; Index < Packed.NumCapsules; ++Index)
+	{
+		const FAnimPhys_PackedCapsules& Pack = Packed.Capsules[Index / 4];
+		const int32 Lane = (Index % 4);
+
+		const FVector SegmentStart(Pack.StartX[Lane], Pack.StartY[Lane], Pack.StartZ[Lane]);
+		const FVector Axis(Pack.AxisX[Lane], Pack.AxisY[Lane], Pack.AxisZ[Lane]);
+
+		const float Time = AnimPhysSweep::RayCapsule(InStartLocation, Dir, SegmentStart, Axis, Pack.LimitDistance[Lane]);
+		if (Time >= 0.0f && Time < HitDistance)
+		{
+			const FVector HitLocation = InStartLocation + Dir * Time;
+			HitDistance = Time;
+			HitNormal = (HitLocation - FMath::ClosestPointOnSegment(HitLocation, SegmentStart, SegmentStart + Axis)).GetSafeNormal();
+		}
+	}
+
+	for (int32 Index = 0; Index < Packed.NumPlanars; ++Index)
+	{
+		const FAnimPhys_PackedPlanars& Pack = Packed.Planars[Index / 4];
+		const int32 Lane = (Index % 4);
+
+		const FVector Normal(Pack.NormalX[Lane], Pack.NormalY[Lane], Pack.NormalZ[Lane]);
+		const float StartDistance = FVector::DotProduct(Normal, InStartLocation) - Pack.W[Lane] - Pack.LimitDistance[Lane];
+		const float Approach = -FVector::DotProduct(Normal, Dir);
+		if (StartDistance >= 0.0f && Approach > 0.0f)
+		{
+			const float Time = StartDistance / Approach;
+			if (Time < HitDistance)
+			{
+				HitDistance = Time;
+				HitNormal = Normal;
+			}
+		}
+	}
+
+	if (HitDistance >= Distance)
+	{
+		return;
+	}
+
+	// Slide the rest of the motion along the first contact. Dropping it would stick a bone resting on a surface,
+	// every later sweep would start on it and hit right away
+	const FVector RemainingDelta = Dir * (Distance - HitDistance);
+	const float IntoSurface = FMath::Min(0.0f, FVector::DotProduct(RemainingDelta, HitNormal));
+	OutBoneLocation = InStartLocation + Dir * HitDistance + (RemainingDelta - HitNormal * IntoSurface);
+}
+
+void FAnimPhys_WorkData::AdjustBoneLocation(const int32 InBoneIndex, FVector& OutBoneLocation) const
+{
+	const FAnimPhys_PackedColliders& Packed = GetPackedColliders(InBoneIndex, OutBoneLocation);
+
+	// Each pack is tested against the bone at once. Colliders are resolved in order, so on a hit
+	// the lanes from the first hit are resolved one by one against the updated location.
+
+	// AdjustBySphereCollision
+	for (const FAnimPhys_PackedSpheres& Pack : Packed.Spheres)
+	{
+		const VectorRegister4Float DeltaX = VectorSubtract(VectorSetFloat1(OutBoneLocation.X), VectorLoadAligned(Pack.CenterX));
+		const VectorRegister4Float DeltaY = VectorSubtract(VectorSetFloat1(OutBoneLocation.Y), VectorLoadAligned(Pack.CenterY));
+		const VectorRegister4Float DeltaZ = VectorSubtract(VectorSetFloat1(OutBoneLocation.Z), VectorLoadAligned(Pack.CenterZ));
+		const VectorRegister4Float DistSquared = VectorMultiplyAdd(DeltaZ, DeltaZ, VectorMultiplyAdd(DeltaY, DeltaY, VectorMultiply(DeltaX, DeltaX)));
+
+		const uint32 HitMask = VectorMaskBits(VectorCompareLE(DistSquared, VectorLoadAligned(Pack.LimitDistanceSquared)));
+		if (HitMask == 0)
+		{
+			continue;
+		}
+
+		for (uint32 Lane = FMath::CountTrailingZeros(HitMask); Lane < 4; ++Lane)
+		{
+			const FVector Center(Pack.CenterX[Lane], Pack.CenterY[Lane], Pack.CenterZ[Lane]);
+			if ((OutBoneLocation - Center).SizeSquared() > Pack.LimitDistanceSquared[Lane])
+			{
+				continue;
+			}
+
+			OutBoneLocation = Center + (OutBoneLocation - Center).GetSafeNormal() * Pack.LimitDistance[Lane];
+		}
+	}
+
+	// AdjustByCapsuleCollision
+	for (const FAnimPhys_PackedCapsules& Pack : Packed.Capsules)
+	{
+		const VectorRegister4Float AxisX = VectorLoadAligned(Pack.AxisX);
+		const VectorRegister4Float AxisY = VectorLoadAligned(Pack.AxisY);
+		const VectorRegister4Float AxisZ = VectorLoadAligned(Pack.AxisZ);
+
+		const VectorRegister4Float ToBoneX = VectorSubtract(VectorSetFloat1(OutBoneLocation.X), VectorLoadAligned(Pack.StartX));
+		const VectorRegister4Float ToBoneY = VectorSubtract(VectorSetFloat1(OutBoneLocation.Y), VectorLoadAligned(Pack.StartY));
+		const VectorRegister4Float ToBoneZ = VectorSubtract(VectorSetFloat1(OutBoneLocation.Z), VectorLoadAligned(Pack.StartZ));
+
+		VectorRegister4Float Alpha = VectorMultiplyAdd(ToBoneZ, AxisZ, VectorMultiplyAdd(ToBoneY, AxisY, VectorMultiply(ToBoneX, AxisX)));
+		Alpha = VectorMultiply(Alpha, VectorLoadAligned(Pack.InvAxisSizeSquared));
+		Alpha = VectorMin(VectorMax(Alpha, VectorZeroFloat()), VectorOneFloat());
+
+		const VectorRegister4Float DeltaX = VectorNegateMultiplyAdd(Alpha, AxisX, ToBoneX);
+		const VectorRegister4Float DeltaY = VectorNegateMultiplyAdd(Alpha, AxisY, ToBoneY);
+		const VectorRegister4Float DeltaZ = VectorNegateMultiplyAdd(Alpha, AxisZ, ToBoneZ);
+		const VectorRegister4Float DistSquared = VectorMultiplyAdd(DeltaZ, DeltaZ, VectorMultiplyAdd(DeltaY, DeltaY, VectorMultiply(DeltaX, DeltaX)));
+
+		const uint32 HitMask = VectorMaskBits(VectorCompareLE(DistSquared, VectorLoadAligned(Pack.LimitDistanceSquared)));
+		if (HitMask == 0)
+		{
+			continue;
+		}
+
+		for (uint32 Lane = FMath::CountTrailingZeros(HitMask); Lane < 4; ++Lane)
+		{
+			const FVector SegmentStart(Pack.StartX[Lane], Pack.StartY[Lane], Pack.StartZ[Lane]);
+			const FVector SegmentAxis(Pack.AxisX[Lane], Pack.AxisY[Lane], Pack.AxisZ[Lane]);
+
+			const float SegmentAlpha = FMath::Clamp(FVector::DotProduct(OutBoneLocation - SegmentStart, SegmentAxis) * Pack.InvAxisSizeSquared[Lane], 0.0f, 1.0f);
+			const FVector ClosestPoint = SegmentStart + SegmentAxis * SegmentAlpha;
+
+			if ((OutBoneLocation - ClosestPoint).SizeSquared() > Pack.LimitDistanceSquared[Lane])
+			{
+				continue;
+			}
+
+			OutBoneLocation = ClosestPoint + (OutBoneLocation - ClosestPoint).GetSafeNormal() * Pack.LimitDistance[Lane];
+		}
+	}
+
+	// AdjustByPlanerCollision
+	for (const FAnimPhys_PackedPlanars& Pack : Packed.Planars)
+	{
+		// Intersects when the signed distance is less than the limit, including anything behind the plane
+		VectorRegister4Float Dist = VectorMultiply(VectorSetFloat1(OutBoneLocation.X), VectorLoadAligned(Pack.NormalX));
+		Dist = VectorMultiplyAdd(VectorSetFloat1(OutBoneLocation.Y), VectorLoadAligned(Pack.NormalY), Dist);
+		Dist = VectorMultiplyAdd(VectorSetFloat1(OutBoneLocation.Z), VectorLoadAligned(Pack.NormalZ), Dist);
+		Dist = VectorSubtract(Dist, VectorLoadAligned(Pack.W));
+
+		const uint32 HitMask = VectorMaskBits(VectorCompareLT(Dist, VectorLoadAligned(Pack.LimitDistance)));
+		if (HitMask == 0)
+		{
+			continue;
+		}
+
+		for (uint32 Lane = FMath::CountTrailingZeros(HitMask); Lane < 4; ++Lane)
+		{
+			const FVector Normal(Pack.NormalX[Lane], Pack.NormalY[Lane], Pack.NormalZ[Lane]);
+			const float SignedDist = FVector::DotProduct(OutBoneLocation, Normal) - Pack.W[Lane];
+			if (SignedDist >= Pack.LimitDistance[Lane])
+			{
+				continue;
+			}
+
+			OutBoneLocation += Normal * (Pack.LimitDistance[Lane] - SignedDist);
+		}
+	}
+
+	// AdjustByFloorCollision
+	if (Collided.Floor.bValid)
+	{
+		const FVector PointOnPlane = FVector::PointPlaneProject(OutBoneLocation, Collided.Floor.Plane);
+		const FVector Direction = (OutBoneLocation - PointOnPlane);
+		const float DistSquared = Direction.SizeSquared();
+
+		bool bIntersects = (DistSquared < Collided.Floor.LimitDistanceSquared);
+		if (bIntersects == false)
+		{
+			bIntersects = (FVector::DotProduct(Direction.GetSafeNormal(), Collided.Floor.Plane.GetNormal()) < 0.0f);
+		}
+
+		if (bIntersects)
+		{
+			OutBoneLocation = PointOnPlane + Collided.Floor.Plane.GetNormal() * Collided.Floor.LimitDistance;
+		}
+	}
+
+}
+
+void FAnimPhys_WorkData::AdjustBoneLength(const int32 InBoneIndex, FVector& OutBoneLocation) const
+{
+	const FVector ParentBoneLocation = Simulated.Locations[Simulated.Topology[InBoneIndex].ParentIndex];
+
+	OutBoneLocation = (OutBoneLocation - ParentBoneLocation).GetSafeNormal() * Simulated.BoneLengths[InBoneIndex] + ParentBoneLocation;
+}
+
+void FAnimPhys_WorkData::AdjustBoneDirection(const FVector& InParentBoneLocation, const int32 InBoneIndex, FVector& OutBoneLocation) const
+{
+	const FAnimPhys_AngleLimits& AngleLimits = Simulated.AngleLimits;
+	if (AngleLimits.bConeEnabled == false && AngleLimits.bAxisEnabled == false)
+	{
+		return;
+	}
+
+	const int32 ParentIndex = Simulated.Topology[InBoneIndex].ParentIndex;
+
+	bool bAdjusted = false;
+	FVector BoneDir = (OutBoneLocation - InParentBoneLocation).GetSafeNormal();
+	const FVector PoseDir = (Simulated.PoseLocations[InBoneIndex] - Simulated.PoseLocations[ParentIndex]).GetSafeNormal();
+
+	if (AngleLimits.bConeEnabled)
+	{
+		// Put the bone back on the cone, in the plane of the pose and the bone direction
+		const float Cos = FVector::DotProduct(PoseDir, BoneDir);
+		if (Cos < AngleLimits.ConeCos)
+		{
+			const FVector Tangent = (BoneDir - PoseDir * Cos).GetSafeNormal();
+			if (Tangent.IsZero() == false)
+			{
+				BoneDir = PoseDir * AngleLimits.ConeCos + Tangent * AngleLimits.ConeSin;
+				bAdjusted = true;
+			}
+		}
+	}
+	else
+	{
+		const FQuat& PoseRotation = Simulated.PoseRotations[InBoneIndex];
+
+		if (TryAdjustBoneDirectionByAngleLimitAxis(PoseRotation.GetAxisX(), PoseDir, AngleLimits.AxisX, BoneDir))
 		{
 			bAdjusted = true;
 		}
 
-		if (TryAdjustBoneDirectionByAngleLimitAxis(AxisY, PoseDir, InSetupSettings.LimitAngleY, BoneDir))
+		if (TryAdjustBoneDirectionByAngleLimitAxis(PoseRotation.GetAxisY(), PoseDir, AngleLimits.AxisY, BoneDir))
 		{
 			bAdjusted = true;
 		}
 
-		if (TryAdjustBoneDirectionByAngleLimitAxis(AxisZ, PoseDir, InSetupSettings.LimitAngleZ, BoneDir))
+		if (TryAdjustBoneDirectionByAngleLimitAxis(PoseRotation.GetAxisZ(), PoseDir, AngleLimits.AxisZ, BoneDir))
 		{
 			bAdjusted = true;
 		}
@@ -615,36 +1669,68 @@ void FAnimPhys_WorkData::AdjustBoneDirection(const FVector& InParentBoneLocation
 	}
 }
 
-bool FAnimPhys_WorkData::TryAdjustBoneDirectionByAngleLimitAxis(const FVector& InAxis, const FVector& InPoseDir, const FVector2D& InLimitAngleAxis, FVector& OutBoneDir) const
+bool FAnimPhys_WorkData::TryAdjustBoneDirectionByAngleLimitAxis(const FVector& InAxis, const FVector& InPoseDir, const FAnimPhys_AxisAngleLimit& InLimit, FVector& OutBoneDir) const
 {
-	if (InLimitAngleAxis.IsZero())
+	if (InLimit.bEnabled == false)
 	{
 		return false;
 	}
 
-	const float AngleX_Pose = FMath::RadiansToDegrees(FMath::Acos(FVector::DotProduct(InAxis, InPoseDir)));
-	const float AngleX_Bone = FMath::RadiansToDegrees(FMath::Acos(FVector::DotProduct(InAxis, OutBoneDir)));
-	const float AngleX_Diff = (AngleX_Pose - AngleX_Bone);
+	// The difference between the pose and the bone angle to the axis has to stay in [Min, Max],
+	// so the bone angle has to stay in [PoseAngle - Max, PoseAngle - Min]. Both ends are built
+	// with the angle difference identities instead of Acos.
+	const float PoseCos = FVector::DotProduct(InAxis, InPoseDir);
+	const float PoseSin = FMath::Sqrt(FMath::Max(0.0f, 1.0f - PoseCos * PoseCos));
+	const float BoneCos = FVector::DotProduct(InAxis, OutBoneDir);
+
+	float TargetCos = 0.0f;
+	float TargetSin = 0.0f;
+	bool bOverLimit = false;
+
+	// Bone angle above PoseAngle - Min
+	TargetCos = PoseCos * InLimit.MinCos + PoseSin * InLimit.MinSin;
+	TargetSin = PoseSin * InLimit.MinCos - PoseCos * InLimit.MinSin;
+	if (TargetSin >= 0.0f)
+	{
+		bOverLimit = (BoneCos < TargetCos);
+	}
+	else
+	{
+		// Target outside of [0, 180], always over when below zero and never when above 180
+		bOverLimit = (InLimit.Min > 0.0f);
+	}
 
-	const float LimitX_Min = InLimitAngleAxis.GetMin();
-	const float LimitX_Max = InLimitAngleAxis.GetMax();
-	if (AngleX_Diff < LimitX_Min)
+	if (bOverLimit == false)
 	{
-		const float AngleX_OverLimit = AngleX_Diff - LimitX_Min;
-		OutBoneDir = OutBoneDir.RotateAngleAxis(AngleX_OverLimit, FVector::CrossProduct(InAxis, OutBoneDir).GetSafeNormal());
-		return true;
+		// Bone angle below PoseAngle - Max
+		TargetCos = PoseCos * InLimit.MaxCos + PoseSin * InLimit.MaxSin;
+		TargetSin = PoseSin * InLimit.MaxCos - PoseCos * InLimit.MaxSin;
+		if (TargetSin >= 0.0f)
+		{
+			bOverLimit = (BoneCos > TargetCos);
+		}
+		else
+		{
+			bOverLimit = (InLimit.Max < 0.0f);
+		}
 	}
-	else if (AngleX_Diff > LimitX_Max)
+
+	if (bOverLimit == false)
 	{
-		const float AngleX_OverLimit = AngleX_Diff - LimitX_Max;
-		OutBoneDir = OutBoneDir.RotateAngleAxis(AngleX_OverLimit, FVector::CrossProduct(InAxis, OutBoneDir).GetSafeNormal());
-		return true;
+		return false;
 	}
 
-	return false;
+	const FVector Tangent = (OutBoneDir - InAxis * BoneCos).GetSafeNormal();
+	if (Tangent.IsZero())
+	{
+		return false;
+	}
+
+	OutBoneDir = InAxis * TargetCos + Tangent * TargetSin;
+	return true;
 }
 
-bool FAnimPhys_WorkData::IsInvalidSimulatedBones(const FCompactPose& InPose) const
+bool FAnimPhys_WorkData::IsInvalidSimulatedBones(const FCompactPose& InPose, const int32 InMaxSimulatedBones, const int32 InDecimationStep) const
 {
-	return (Simulated.SimulatedBones.IsEmpty() || Simulated.CapturedPoseBonesNum != InPose.GetNumBones());
+	return (Simulated.IsEmpty() || Simulated.CapturedPoseBonesNum != InPose.GetNumBones() || Simulated.MaxSimulatedBones != InMaxSimulatedBones || Simulated.DecimationStep != InDecimationStep);
 }
\ No newline at end of file
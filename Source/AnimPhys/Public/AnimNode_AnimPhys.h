@@ -5,9 +5,13 @@
 #include "BoneContainer.h"
 #include "BonePose.h"
 #include "AnimPhysWorkData.h"
+#include "AnimPhysQuality.h"
+#include "Tasks/Task.h"
 #include "AnimNode_AnimPhys.generated.h"
 
 class USkeletalMeshComponent;
+class UAnimPhysSubsystem;
+struct FAnimNode_AnimPhys;
 
 struct FAnimPhys_EditData
 {
@@ -17,6 +21,44 @@ struct FAnimPhys_EditData
 	FCSPose<FCompactHeapPose> ForwardedPose;
 };
 
+// The task solving the steps of a node. It refers to the node, so nodes are never copied while it runs and wait for it when destroyed.
+// A finished task may still hold its handle until the next wait, copies only start without it
+struct FAnimPhys_PipelinedSolve
+{
+	FAnimPhys_PipelinedSolve() = default;
+	FAnimPhys_PipelinedSolve(const FAnimPhys_PipelinedSolve& Other) { check(Other.IsRunning() == false); }
+	~FAnimPhys_PipelinedSolve() { Wait(); }
+
+	FAnimPhys_PipelinedSolve& operator=(const FAnimPhys_PipelinedSolve& Other)
+	{
+		check(IsRunning() == false && Other.IsRunning() == false);
+		Wait();
+		return *this;
+	}
+
+	template<typename TaskBodyType>
+	void Launch(TaskBodyType&& InTaskBody)
+	{
+		check(IsValid() == false);
+		Task = UE::Tasks::Launch(UE_SOURCE_LOCATION, Forward<TaskBodyType>(InTaskBody));
+	}
+
+	void Wait()
+	{
+		if (Task.IsValid())
+		{
+			Task.Wait();
+			Task = UE::Tasks::FTask();
+		}
+	}
+
+	bool IsValid() const { return Task.IsValid(); }
+	bool IsRunning() const { return Task.IsValid() && Task.IsCompleted() == false; }
+
+private:
+	UE::Tasks::FTask Task;
+};
+
 struct FAnimPhys_NodeData
 {
 	bool bIsSequencerBound = false;
@@ -35,14 +77,97 @@ struct FAnimPhys_NodeData
 	float WorldTimeSeconds = 0.0f;
 	float LastEvalTimeSeconds = 0.0f;
 	float SuspendedSimTimeSeconds = 0.0f;
+	float FixedTimeStepAccumulator = 0.0f;
+	float FixedTimeStepAlpha = 1.0f;
+	int32 NumFixedTimeSteps = 0;
 	float StartedSmoothingTimeSeconds = 0.0f;
 
+	// Steps prepared by the evaluation, solved inline or by the subsystem
+	int32 NumPendingSteps = 0;
+	float PendingDeltaTime = 0.0f;
+	float PendingLastDeltaTime = 0.0f;
+	FAnimPhysSetupSettings PendingSetupSettings;
+	FAnimPhysExternalForceSettings PendingExternalForceSettings;
+	FAnimPhysSmoothingSettings PendingSmoothingSettings;
+	FAnimPhysSimulationSettings PendingSimulationSettings;
+	bool bPendingFixedSteps = false;
+	bool bPendingBatchedSolve = false;
+	bool bPendingPipelinedSolve = false;
+
+	// Set when the evaluation started solving before its input pose was evaluated
+	bool bPreparedBeforePose = false;
+	bool bSolvedBeforePose = false;
+
+	// Enqueued with the subsystem, which copies the bone transforms of the next frame
+	bool bPendingFrameNode = false;
+	bool bBoneTransformsCopied = false;
+
+	// Latched from sg.AnimPhysQuality, the predicted LOD and the budget by PreUpdate
+	FAnimPhysQuality Quality;
+	int32 PredictedLOD = 0;
+	uint32 LODColliderTypes = AnimPhysColliderTypes::All;
+	uint32 LODSolverFeatures = MAX_uint32;
+	int32 LODDecimationStep = 1;
+	EAnimPhysDegradation Degradation = EAnimPhysDegradation::None;
+	FAnimPhysSimulationSettings ScaledSimulationSettings;
+	bool bSkipStep = false;
+	float SkippedDeltaTime = 0.0f;
+	int32 NumCatchUpSteps = 1;
+
+	// Not rendered while bSkipWhileNotRendered is set
+	bool bOffscreen = false;
+	bool bReturnedOnscreen = false;
+	float OffscreenSinceSeconds = 0.0f;
+
+	// Own cadence of the solver, evaluations in between blend the last two solver states.
+	// Counts frames instead while the update rate optimizations skip evaluations
+	int32 SimulationRateDivisor = 1;
+	int32 EvaluationsSinceStep = 0;
+	float FrameDeltaSeconds = 0.0f;
+	uint64 LastRateFrameCounter = 0;
+	float StepBlendAlpha = 1.0f;
+	bool bPendingStepBlend = false;
+
+	// Deferred solves apply their steps one evaluation later, with the blend alpha of the evaluation that prepared them
+	float LastBlendAlpha = 1.0f;
+
+	TWeakObjectPtr<UAnimPhysSubsystem> Subsystem;
+	FAnimPhys_PipelinedSolve PipelinedSolve;
+
+	// Address the node registered with the subsystem under, a copy of the node has to register again
+	const FAnimNode_AnimPhys* RegisteredNode = nullptr;
+
+	// Nothing is gathered or simulated until woken up from the pose
+	bool bDormant = false;
+
 	bool bPhysBodyWasSimulated = false;
+
+	// What the bodies were last checked against
+	bool bAllPhysBodiesSimulated = false;
+	int32 PhysBodyGeneration = INDEX_NONE;
+	int32 NumPhysBodies = INDEX_NONE;
+	const USkeletalMeshComponent* PhysBodyComponent = nullptr;
 	bool bWindWasEnabled = false;
 
 	EAnimPhysDisabledState AnimPhysDisabledStateByOwner = EAnimPhysDisabledState::None;
 };
 
+// Written by the budget pass of UAnimPhysSubsystem on the game thread
+struct FAnimPhys_BudgetData
+{
+	EAnimPhysDegradation Degradation = EAnimPhysDegradation::None;
+
+	// Steps on the frames where (frame + phase) is a multiple of the divisor
+	uint32 RateDivisor = 1;
+	uint32 RatePhase = 0;
+
+	float Significance = 0.0f;
+	float CostMs = 0.0f;
+
+	// Measured since the last budget pass
+	uint64 CostCycles = 0;
+};
+
 USTRUCT(BlueprintType)
 struct ANIMPHYS_API FAnimNode_AnimPhys : public FAnimNode_Base
 {
@@ -61,13 +186,27 @@ public:
 	virtual void PreUpdate(const UAnimInstance* RESTRICT InAnimInstance) override;
 	virtual bool NeedsDynamicReset() const override { return true; }
 	virtual void ResetDynamics(ETeleportType InTeleportType) override;
+
+	// Used by UAnimPhysSubsystem for batched solves
+	void SolvePendingSteps();
+	int32 GetNumPendingBones() const { return WorkData.Simulated.Num() * NodeData.NumPendingSteps; }
+	const FAnimPhys_CompiledSetup* GetCompiledSetup() const { return WorkData.Simulated.Setup.Get(); }
+	bool CanSolveInLanesWith(const FAnimNode_AnimPhys& InOther) const;
+
+	// Steps nodes of the same compiled setup together, one node per SIMD lane
+	static void SolvePendingStepsInLanes(TConstArrayView<FAnimNode_AnimPhys*> InNodes);
+
+	// Used by UAnimPhysSubsystem once the node was enqueued by PreUpdate, optionally copies the bone transforms of the next PreUpdate
+	void EndFrame(USkeletalMeshComponent* RESTRICT MeshComponent, const bool bInCopyBoneTransforms);
+	FAnimPhys_BudgetData& GetBudgetData() { return BudgetData; }
+	const FAnimPhys_BudgetData& GetBudgetData() const { return BudgetData; }
 	
 #if WITH_EDITOR
 	void OnObjectPropertyChanged(UObject* Object, FPropertyChangedEvent& PropertyChangedEventEvent);
 	void ResetSimulatedBones();
 	void ResetColliders();
 	FCSPose<FCompactHeapPose>& GetForwardedPose() { return EditData.ForwardedPose; }
-	const TArray<FAnimPhys_SimulatedBone_WorkData>& GetSimulatedBones() const { return WorkData.Simulated.SimulatedBones; }
+	const FAnimPhys_Simulated_WorkData& GetSimulatedBones() const { return WorkData.Simulated; }
 	const FAnimPhys_Collided_WorkData& GetColliders() const { return WorkData.Collided; }
 #endif
 
@@ -80,30 +219,61 @@ private:
 	void BuildCachedTransformIndexes(USkeletalMeshComponent* RESTRICT MeshComponent);
 	void BuildCachedAttachedTransformIndexes(USkeletalMeshComponent* RESTRICT MeshComponent);
 
+	void GatherInputs(USkeletalMeshComponent* RESTRICT MeshComponent);
+	void CancelFrameNode();
+	void ApplyQuality();
+	void ApplyLOD();
+	void ApplyBudget();
+	uint32 GetColliderTypes() const;
+	const FAnimPhysSimulationSettings& GetSimulationSettings() const;
+	void ComputeSimulationRate(const USkeletalMeshComponent* RESTRICT MeshComponent);
+	void ComputeOffscreen(const USkeletalMeshComponent* RESTRICT MeshComponent);
+	float GetFixedDeltaTime() const;
+	float GetBlendAlpha() const;
+
 	bool IsWindEnabled(const USkeletalMeshComponent* RESTRICT MeshComponent) const;
 	void ComputeWind(const USkeletalMeshComponent* RESTRICT MeshComponent);
 
 	bool IsAllPhysBodiesSimulated(const USkeletalMeshComponent* RESTRICT MeshComponent) const;
+	int32 ComputePhysBodyGeneration(const USkeletalMeshComponent* RESTRICT MeshComponent) const;
+	bool IsPhysBodyStateUnchanged(const USkeletalMeshComponent* RESTRICT MeshComponent);
 	void ComputePhysBody(const USkeletalMeshComponent* RESTRICT MeshComponent);
 	void ComputeFloor(const USkeletalMeshComponent* RESTRICT MeshComponent);
 
 	void BuildColliders(const USkeletalMeshComponent* RESTRICT MeshComponent);
-	void BuildSphereColliders(const FReferenceSkeleton& RefSkeleton, const bool bFromAttachedMesh, const TArray<FAnimPhysSphereCollider>& SphereColliders);
-	void BuildCapsuleColliders(const FReferenceSkeleton& RefSkeleton, const bool bFromAttachedMesh, const TArray<FAnimPhysCapsuleCollider>& CapsuleColliders);
-	void BuildPlanarColliders(const FReferenceSkeleton& RefSkeleton, const bool bFromAttachedMesh, const TArray<FAnimPhysPlanarCollider>& PlanarColliders);
+	void AddCompiledColliders(const USkeletalMesh* SkeletalMesh, const UAnimPhysCollisionData* CollisionData, const bool bFromAttachedMesh, const TArray<FAnimPhysSphereCollider>& SphereColliders, const TArray<FAnimPhysCapsuleCollider>& CapsuleColliders, const TArray<FAnimPhysPlanarCollider>& PlanarColliders);
+	void BuildSphereColliders(FAnimPhys_CompiledColliders& OutColliders, const FReferenceSkeleton& RefSkeleton, const bool bFromAttachedMesh, const TArray<FAnimPhysSphereCollider>& SphereColliders) const;
+	void BuildCapsuleColliders(FAnimPhys_CompiledColliders& OutColliders, const FReferenceSkeleton& RefSkeleton, const bool bFromAttachedMesh, const TArray<FAnimPhysCapsuleCollider>& CapsuleColliders) const;
+	void BuildPlanarColliders(FAnimPhys_CompiledColliders& OutColliders, const FReferenceSkeleton& RefSkeleton, const bool bFromAttachedMesh, const TArray<FAnimPhysPlanarCollider>& PlanarColliders) const;
 	void BuildPhysBodyColliders(const USkeletalMeshComponent* RESTRICT MeshComponent);
-	void BuildPhysBodyCollidersFromPhysicsAsset(const FReferenceSkeleton& RefSkeleton, const UPhysicsAsset* PhysicsAsset, const bool bFromAttachedMesh);
+	void AddCompiledPhysBodyColliders(const USkeletalMesh* SkeletalMesh, const UPhysicsAsset* PhysicsAsset, const bool bFromAttachedMesh);
+	void BuildPhysBodyCollidersFromPhysicsAsset(FAnimPhys_CompiledColliders& OutColliders, const FReferenceSkeleton& RefSkeleton, const UPhysicsAsset* PhysicsAsset, const bool bFromAttachedMesh) const;
 
 	bool IsAnimPhysValid(const FPoseContext& RESTRICT Context) const;
+	bool IsDormant() const;
+	void EnterDormant();
+	void WakeUp();
 	bool IsAnimPhysEnabled() const;
 	void EvaluateAnimPhys(FPoseContext& RESTRICT Output);
 
+	void ComputeSkippedTime();
+	void ComputeFixedTimeStep();
 	void ComputeComponentMovement(FPoseContext& RESTRICT Output);
 	void ComputePoseTransform(FPoseContext& RESTRICT Output);
 	void ComputeColliderTransform(FPoseContext& RESTRICT Output);
 	void ComputeSphereColliderTransform(TArray<FAnimPhys_CollidedSphere_WorkData>& RESTRICT CollidedSpheres);
 	void ComputeCapsuleColliderTransform(TArray<FAnimPhys_CollidedCapsule_WorkData>& RESTRICT CollidedCapsules);
+	void ComputeEnabledForces();
 	void SimulateBones(FPoseContext& RESTRICT Output);
+	void PreparePendingSteps();
+	void FlushPendingSolve();
+	void CancelBatchedSolve();
+
+	bool IsPipelined(const EAnimPhysPipelineLatency InLatency) const;
+	void PrepareBeforePose(FPoseContext& RESTRICT Output);
+	void LaunchPipelinedSolve();
+	void SolveAndMeasurePendingSteps();
+	void WaitPipelinedSolve();
 	
 	void CopyBoneTransformsFromPose(const FCompactPose& RESTRICT Pose);
 
@@ -150,9 +320,16 @@ public:
 	UPROPERTY(EditAnywhere, Category = Settings)
 	FAnimPhysSmoothingSettings SmoothingSettings;
 
+	UPROPERTY(EditAnywhere, Category = Settings)
+	FAnimPhysSimulationSettings SimulationSettings;
+
+	UPROPERTY(EditAnywhere, Category = Settings)
+	FAnimPhysLODSettings LODSettings;
+
 private:
 	FAnimPhys_WorkData WorkData;
 	FAnimPhys_NodeData NodeData;
+	FAnimPhys_BudgetData BudgetData;
 
 #if WITH_EDITORONLY_DATA
 	FAnimPhys_EditData EditData;
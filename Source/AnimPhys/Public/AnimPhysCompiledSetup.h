@@ -0,0 +1,218 @@
+// Copyright NEXON Games Co., MIT License
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BoneContainer.h"
+#include "Misc/ScopeLock.h"
+#include "UObject/ObjectKey.h"
+#include "AnimPhysCollisionData.h"
+
+struct ANIMPHYS_API FAnimPhys_SimulatedBone_Topology
+{
+	FAnimPhys_SimulatedBone_Topology()
+		: MeshPoseBoneIndex(INDEX_NONE)
+		, ParentMeshPoseBoneIndex(INDEX_NONE)
+	{}
+
+	int32 ParentIndex = INDEX_NONE;
+	int32 LastChildIndex = INDEX_NONE;
+	int32 NumChildren = 0;
+	int32 ChainIndex = INDEX_NONE;
+
+	// Set when the direct parent is a decimated bone, ParentIndex is then the nearest simulated ancestor
+	int32 DecimatedParentIndex = INDEX_NONE;
+
+	FMeshPoseBoneIndex MeshPoseBoneIndex;
+
+	// Only set on roots
+	FMeshPoseBoneIndex ParentMeshPoseBoneIndex;
+};
+
+// A chain bone that is not simulated, it is rebuilt from the simulated bones around it when applying
+struct ANIMPHYS_API FAnimPhys_DecimatedBone_Topology
+{
+	FAnimPhys_DecimatedBone_Topology()
+		: MeshPoseBoneIndex(INDEX_NONE)
+	{}
+
+	// Nearest simulated ancestor
+	int32 SimulatedParentIndex = INDEX_NONE;
+
+	// Set when the direct parent is decimated as well
+	int32 DecimatedParentIndex = INDEX_NONE;
+
+	// Nearest simulated descendant and how far down the segment to it the bone is, left unset when the cap of the chain excluded it
+	int32 SimulatedChildIndex = INDEX_NONE;
+	float SegmentAlpha = 0.0f;
+
+	FMeshPoseBoneIndex MeshPoseBoneIndex;
+};
+
+// Everything about the simulated bones that only depends on the required bones and the node settings.
+// Shared by all instances that resolve to the same key, so it is never modified once compiled.
+struct ANIMPHYS_API FAnimPhys_CompiledSetup
+{
+	TArray<FAnimPhys_SimulatedBone_Topology> Topology;
+	TArray<int32> ChainRootIndexes;
+	TArray<FAnimPhys_DecimatedBone_Topology> DecimatedBones;
+
+public:
+	void Compile(const FBoneContainer& InRequiredBones, const TArray<FBoneReference>& InBonesToSimulate, const TArray<FBoneReference>& InBonesToExculude, const bool bInBuildEndBones, const int32 InMaxSimulatedBones, const int32 InDecimationStep);
+
+	// Single pass over bones in compact pose order, where every parent comes before its children.
+	// OutBoneIndexes gets the compact pose index of each simulated bone, INDEX_NONE for end bones.
+	// A positive InMaxSimulatedBones caps the simulated and end bones in total. It is split evenly between the chains,
+	// bones beyond their share are left out from the tip, and chains beyond the cap are left out entirely.
+	// With InDecimationStep above 1 only every InDecimationStep-th bone down a chain is simulated, the others go to OutDecimatedBones
+	// and OutDecimatedBoneIndexes gets their compact pose indexes. Tips and branching bones are always simulated.
+	static void CompileTopology(TConstArrayView<int32> InParentIndexes, TConstArrayView<int32> InRootIndexes, TConstArrayView<int32> InExcludedIndexes, const bool bInBuildEndBones, const int32 InMaxSimulatedBones, const int32 InDecimationStep,
+		TArray<FAnimPhys_SimulatedBone_Topology>& OutTopology, TArray<int32>& OutChainRootIndexes, TArray<int32>& OutBoneIndexes,
+		TArray<FAnimPhys_DecimatedBone_Topology>& OutDecimatedBones, TArray<int32>& OutDecimatedBoneIndexes);
+};
+
+struct ANIMPHYS_API FAnimPhys_CompiledSetupKey
+{
+	TObjectKey<UObject> Asset;
+	TArray<FBoneIndexType> RequiredBoneIndices;
+	TArray<FName> BonesToSimulate;
+	TArray<FName> BonesToExculude;
+	bool bBuildEndBones = false;
+	int32 MaxSimulatedBones = 0;
+	int32 DecimationStep = 1;
+
+	uint32 Hash = 0;
+
+public:
+	FAnimPhys_CompiledSetupKey(const FBoneContainer& InRequiredBones, const TArray<FBoneReference>& InBonesToSimulate, const TArray<FBoneReference>& InBonesToExculude, const bool bInBuildEndBones, const int32 InMaxSimulatedBones, const int32 InDecimationStep);
+
+	bool operator==(const FAnimPhys_CompiledSetupKey& Other) const;
+	friend uint32 GetTypeHash(const FAnimPhys_CompiledSetupKey& Key) { return Key.Hash; }
+};
+
+// Mesh pose bone to slot tables of the cached component space transforms
+struct ANIMPHYS_API FAnimPhys_CompiledCacheSlots
+{
+	TArray<FMeshPoseBoneIndex> BoneIndexes;
+	TArray<int32> Slots;
+
+public:
+	void Compile(const TArray<int32>& InBoneIndexes, const int32 InNumBones);
+
+	int32 Num() const { return BoneIndexes.Num(); }
+	int32 FindSlot(const FMeshPoseBoneIndex& InMeshPoseBoneIndex) const
+	{
+		return Slots.IsValidIndex(InMeshPoseBoneIndex.GetInt()) ? Slots[InMeshPoseBoneIndex.GetInt()] : INDEX_NONE;
+	}
+};
+
+struct ANIMPHYS_API FAnimPhys_CompiledCacheSlotsKey
+{
+	TArray<int32> BoneIndexes;
+	int32 NumBones = 0;
+
+	uint32 Hash = 0;
+
+public:
+	FAnimPhys_CompiledCacheSlotsKey(const TArray<int32>& InSortedBoneIndexes, const int32 InNumBones);
+
+	bool operator==(const FAnimPhys_CompiledCacheSlotsKey& Other) const { return NumBones == Other.NumBones && BoneIndexes == Other.BoneIndexes; }
+	friend uint32 GetTypeHash(const FAnimPhys_CompiledCacheSlotsKey& Key) { return Key.Hash; }
+};
+
+// Colliders of one mesh, either defined by the node or its collision data, or taken from its physics asset
+struct ANIMPHYS_API FAnimPhys_CompiledCollidersKey
+{
+	TObjectKey<UObject> Mesh;
+	TObjectKey<UObject> Source;
+	float Radius = 0.0f;
+	float PhysBodyScale = 0.0f;
+	bool bFromAttachedMesh = false;
+
+	// Driving bones and shapes of the colliders that are not taken from a physics asset
+	TArray<FName> BoneNames;
+	TArray<float> Shapes;
+
+	uint32 Hash = 0;
+
+public:
+	FAnimPhys_CompiledCollidersKey(const UObject* InMesh, const UObject* InSource, const float InRadius, const float InPhysBodyScale, const bool bInFromAttachedMesh);
+
+	void AddColliders(TConstArrayView<FAnimPhysSphereCollider> InSpheres, TConstArrayView<FAnimPhysCapsuleCollider> InCapsules, TConstArrayView<FAnimPhysPlanarCollider> InPlanars);
+
+	bool operator==(const FAnimPhys_CompiledCollidersKey& Other) const;
+	friend uint32 GetTypeHash(const FAnimPhys_CompiledCollidersKey& Key) { return Key.Hash; }
+
+private:
+	void AddCollider(const FAnimPhysColliderBase& InCollider, const float InRadius, const float InLength);
+};
+
+// Defined with the collided work data it is made of
+struct FAnimPhys_CompiledColliders;
+
+using FAnimPhys_CompiledSetupPtr = TSharedPtr<const FAnimPhys_CompiledSetup, ESPMode::ThreadSafe>;
+using FAnimPhys_CompiledCacheSlotsPtr = TSharedPtr<const FAnimPhys_CompiledCacheSlots, ESPMode::ThreadSafe>;
+using FAnimPhys_CompiledCollidersPtr = TSharedPtr<const FAnimPhys_CompiledColliders, ESPMode::ThreadSafe>;
+
+// Hands out one compiled object per key while any instance still references it
+template <typename KeyType, typename CompiledType>
+class TAnimPhysCompiledRegistry
+{
+public:
+	using FCompiledPtr = TSharedPtr<const CompiledType, ESPMode::ThreadSafe>;
+
+	template <typename CompileFuncType>
+	FCompiledPtr FindOrCompile(const KeyType& InKey, CompileFuncType&& InCompile)
+	{
+		{
+			FScopeLock Lock(&CriticalSection);
+			if (FCompiledPtr Found = Find(InKey))
+			{
+				return Found;
+			}
+		}
+
+		// Compiled outside of the lock, so instances with other keys are not blocked
+		TSharedRef<CompiledType, ESPMode::ThreadSafe> NewCompiled = MakeShared<CompiledType, ESPMode::ThreadSafe>();
+		InCompile(*NewCompiled);
+
+		FScopeLock Lock(&CriticalSection);
+		if (FCompiledPtr Found = Find(InKey))
+		{
+			return Found;
+		}
+
+		if (Entries.Num() >= NextPruneNum)
+		{
+			for (auto It = Entries.CreateIterator(); It; ++It)
+			{
+				if (It.Value().IsValid() == false)
+				{
+					It.RemoveCurrent();
+				}
+			}
+
+			NextPruneNum = FMath::Max(64, Entries.Num() * 2);
+		}
+
+		Entries.Add(InKey, NewCompiled);
+		return NewCompiled;
+	}
+
+private:
+	FCompiledPtr Find(const KeyType& InKey) const
+	{
+		const TWeakPtr<const CompiledType, ESPMode::ThreadSafe>* Found = Entries.Find(InKey);
+		return Found ? Found->Pin() : FCompiledPtr();
+	}
+
+	FCriticalSection CriticalSection;
+	TMap<KeyType, TWeakPtr<const CompiledType, ESPMode::ThreadSafe>> Entries;
+	int32 NextPruneNum = 64;
+};
+
+namespace AnimPhysCompiledSetup
+{
+	ANIMPHYS_API FAnimPhys_CompiledSetupPtr FindOrCompile(const FBoneContainer& InRequiredBones, const TArray<FBoneReference>& InBonesToSimulate, const TArray<FBoneReference>& InBonesToExculude, const bool bInBuildEndBones, const int32 InMaxSimulatedBones, const int32 InDecimationStep);
+	ANIMPHYS_API FAnimPhys_CompiledCacheSlotsPtr FindOrCompileCacheSlots(const TArray<int32>& InBoneIndexes, const int32 InNumBones);
+	ANIMPHYS_API FAnimPhys_CompiledCollidersPtr FindOrCompileColliders(const FAnimPhys_CompiledCollidersKey& InKey, TFunctionRef<void(FAnimPhys_CompiledColliders&)> InCompile);
+}
@@ -21,6 +21,10 @@ class IAnimPhysMeshComponentInterface : public IInterface
 
 	virtual void ApplyImpulseToAnimPhys(const FName& InBoneName, const FVector& InImpulse) = 0;
 	virtual const FVector& GetAccumulatedImpulsesToAnimPhys(const FName& InBoneName) const = 0;
+
+	// Changed whenever bodies start or stop simulating, so AnimPhys only checks the bodies again then.
+	// INDEX_NONE lets AnimPhys derive one from the physics state of the component, which is also rechecked periodically.
+	virtual int32 GetPhysBodySimulationGeneration() const { return INDEX_NONE; }
 };
 
 UINTERFACE(MinimalApi, meta = (CannotImplementInterfaceInBlueprint))
@@ -34,4 +38,7 @@ class IAnimPhysActorInterface : public IInterface
 	GENERATED_IINTERFACE_BODY()
 
 	virtual bool GetWindStrengthCombinedGust(const FWindChannels& InWindChannels, const FVector& InPosition, FVector& OutDirection, float& OutSpeed) = 0;
+
+	// Scales the significance the AnimPhys budget ranks the nodes of this actor by
+	virtual float GetAnimPhysImportance() const { return 1.0f; }
 };
\ No newline at end of file
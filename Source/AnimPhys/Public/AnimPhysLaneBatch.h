@@ -0,0 +1,47 @@
+// Copyright NEXON Games Co., MIT License
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AnimPhysWorkData.h"
+
+// One bone of every lane
+struct alignas(16) FAnimPhys_LaneVector
+{
+	float X[4];
+	float Y[4];
+	float Z[4];
+};
+
+struct alignas(16) FAnimPhys_LaneScalar
+{
+	float V[4];
+};
+
+// Advances up to NumLanes instances of the same compiled setup together, one instance per SIMD lane.
+// The hot streams are interleaved bone by bone, so bone i of every instance is solved at once.
+struct ANIMPHYS_API FAnimPhys_LaneBatch
+{
+	static constexpr int32 NumLanes = 4;
+
+	TArray<FAnimPhys_WorkData*, TInlineAllocator<NumLanes>> Lanes;
+
+	TArray<FAnimPhys_LaneVector> Locations;
+	TArray<FAnimPhys_LaneVector> PrevLocations;
+	TArray<FAnimPhys_LaneVector> Velocities;
+	TArray<FAnimPhys_LaneVector> PoseLocations;
+	TArray<FAnimPhys_LaneScalar> BoneLengths;
+	TArray<FAnimPhys_LaneScalar> WindNoise;
+
+public:
+	static bool CanShareLanes(const FAnimPhys_WorkData& InA, const FAnimPhys_WorkData& InB);
+
+	// One step of every lane. InParams is indexed like Lanes, lanes without params are not stepped.
+	void SimulateBones(TConstArrayView<const FAnimPhys_SolverParams*> InParams);
+
+	template <uint32 InFeatures>
+	void SimulateBonesKernel(TConstArrayView<const FAnimPhys_SolverParams*> InParams, const uint32 InActiveLanes);
+
+private:
+	void Gather(const bool bInWithWindNoise);
+	void Scatter(const uint32 InActiveLanes);
+};
@@ -0,0 +1,28 @@
+// Copyright NEXON Games Co., MIT License
+#pragma once
+#include "CoreMinimal.h"
+#include "AnimPhysWorkData.h"
+
+// What the solver may do at one level of sg.AnimPhysQuality, 0 means unlimited.
+// Nodes read it every PreUpdate, so a new level applies from the next frame on.
+struct ANIMPHYS_API FAnimPhysQuality
+{
+	// Caps the fixed time step, or raises the simulation rate divisor of nodes without fixed steps
+	float MaxFixedTimeStepRate = 0.0f;
+	int32 MaxSubsteps = 0;
+	int32 MaxConstraintIterations = 0;
+
+	// AnimPhysColliderTypes the nodes may collide with
+	uint32 ColliderTypes = AnimPhysColliderTypes::All;
+	bool bAngleLimits = true;
+
+	// Split between the chains of a node, changing it rebuilds the simulated bones while keeping their state
+	int32 MaxSimulatedBones = 0;
+};
+
+namespace AnimPhysQuality
+{
+	// 0 low, 1 medium, 2 high, 3 epic
+	ANIMPHYS_API int32 GetLevel();
+	ANIMPHYS_API const FAnimPhysQuality& Get();
+}
@@ -0,0 +1,73 @@
+// Copyright NEXON Games Co., MIT License
+#pragma once
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AnimPhysWorkData.h"
+#include "AnimPhysSubsystem.generated.h"
+
+struct FAnimNode_AnimPhys;
+class USkeletalMeshComponent;
+
+// Solves the nodes running in EAnimPhysSolverMode::Batched all at once after the world ticked,
+// degrades the least significant nodes while AnimPhys.Budget.Ms is exceeded,
+// then copies the bone transforms for the next PreUpdate of every node in one parallel pass
+UCLASS()
+class ANIMPHYS_API UAnimPhysSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Nodes are held by address, so a node registers again once it was copied and unregisters when destroyed
+	void RegisterNode(FAnimNode_AnimPhys* InNode);
+	void UnregisterNode(FAnimNode_AnimPhys* InNode);
+
+	// Safe to call from any thread evaluating animation
+	void Submit(FAnimNode_AnimPhys* InNode);
+	void Cancel(FAnimNode_AnimPhys* InNode);
+
+	// Game thread only, every node updated this frame enqueues itself once
+	void EnqueueFrameNode(FAnimNode_AnimPhys* InNode, USkeletalMeshComponent* InMeshComponent, const bool bInCopyBoneTransforms);
+	void CancelFrameNode(FAnimNode_AnimPhys* InNode);
+
+	void DumpBudget(FOutputDevice& Ar) const;
+
+	// Nodes only need the frame pass of the budget while AnimPhys.Budget.Ms is set
+	static bool IsBudgetEnabled();
+
+private:
+	void SolveBatchedNodes();
+	void UpdateBudget();
+	void CopyBoneTransforms();
+
+	struct FFrameNode
+	{
+		FAnimNode_AnimPhys* Node = nullptr;
+		TWeakObjectPtr<USkeletalMeshComponent> MeshComponent;
+		bool bCopyBoneTransforms = false;
+	};
+
+	struct FBudgetEntry
+	{
+		TWeakObjectPtr<const USkeletalMeshComponent> MeshComponent;
+		float Significance = 0.0f;
+		float CostMs = 0.0f;
+		EAnimPhysDegradation Degradation = EAnimPhysDegradation::None;
+	};
+
+	FCriticalSection CriticalSection;
+	TArray<FAnimNode_AnimPhys*> PendingNodes;
+	TArray<FAnimNode_AnimPhys*> SolvingNodes;
+	TArray<int32> LaneGroupStarts;
+	TArray<FFrameNode> PendingFrameNodes;
+	TArray<FFrameNode> FrameNodes;
+	TSet<FAnimNode_AnimPhys*> RegisteredNodes;
+
+	// Last budget pass, for AnimPhys.Budget.Dump
+	TArray<FBudgetEntry> BudgetEntries;
+	float BudgetPredictedMs = 0.0f;
+	uint32 TimeSlicePhase = 0;
+};
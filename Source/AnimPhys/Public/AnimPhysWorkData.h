@@ -33,6 +33,7 @@ SOFTWARE.
 #include "CoreMinimal.h"
 #include "BoneContainer.h"
 #include "AnimPhysCollisionData.h"
+#include "AnimPhysCompiledSetup.h"
 
 #include "AnimPhysWorkData.generated.h"
 
@@ -54,6 +55,42 @@ enum class EAnimPhysDisabledState : uint8
 };
 ENUM_CLASS_FLAGS(EAnimPhysDisabledState);
 
+UENUM()
+enum class EAnimPhysSolverMode : uint8
+{
+	// Solved during the evaluation of the node
+	Inline,
+	// Solved with all other batched nodes of the world at the end of the frame, applied one evaluation later
+	Batched,
+	// Solved on a task that runs alongside the rest of the frame, see PipelineLatency
+	Pipelined,
+};
+
+// Steps UAnimPhysSubsystem goes through for the least significant nodes while over budget
+UENUM()
+enum class EAnimPhysDegradation : uint8
+{
+	None,
+	// One substep and one constraint iteration
+	FewerSubsteps,
+	NoCollision,
+	// Stepped every other frame
+	HalfRate,
+	// Stepped once every AnimPhys.Budget.TimeSlices frames, spread over the frames round-robin
+	TimeSliced,
+	// Holds the last simulated state
+	Frozen,
+};
+
+UENUM()
+enum class EAnimPhysPipelineLatency : uint8
+{
+	// Launched before the input pose is evaluated and applied right after it, the steps are solved against the last pose
+	ZeroFrames,
+	// Launched from PreUpdate and applied by the next evaluation, the output is one evaluation behind
+	OneFrame,
+};
+
 USTRUCT()
 struct ANIMPHYS_API FAnimPhysSetupSettings
 {
@@ -99,9 +136,17 @@ struct ANIMPHYS_API FAnimPhysCollisionSettings
 	UPROPERTY(EditAnywhere)
 	bool bCollidedWithSimulatedPhysBody = false;
 
+	/** Push the bones out of the simulated bodies as well, otherwise the bodies only drive EnabledWhenPhysBodyWasSimulated and the debug draw */
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "bCollidedWithSimulatedPhysBody"))
+	bool bApplyPhysBodyCollision = false;
+
 	UPROPERTY(EditAnywhere)
 	bool bCollidedWithFloor = false;
 
+	/** Sweep bones from their last location, so fast bones do not pass through thin colliders at low rates */
+	UPROPERTY(EditAnywhere)
+	bool bUseSweptCollision = false;
+
 	UPROPERTY(EditAnywhere)
 	TArray<FAnimPhysSphereCollider> SphereColliders;
 
@@ -154,6 +199,10 @@ struct ANIMPHYS_API FAnimPhysExternalForceSettings
 
 	UPROPERTY(EditAnywhere, meta = (EditCondition = "bEnableWind"))
 	float WindScale = 1.0f;
+
+	/** Wind gusts are reproducible for the same seed and owner */
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "bEnableWind"))
+	int32 WindNoiseSeed = 0;
 };
 
 USTRUCT()
@@ -171,57 +220,283 @@ struct ANIMPHYS_API FAnimPhysSmoothingSettings
 	FVector ScaleDampingMultiplier = FVector::OneVector;
 };
 
-struct ANIMPHYS_API FAnimPhys_SimulatedBone_WorkData
+USTRUCT()
+struct ANIMPHYS_API FAnimPhysSimulationSettings
 {
-	FAnimPhys_SimulatedBone_WorkData()
-		: MeshPoseBoneIndex(INDEX_NONE)
-		, CompactPoseBoneIndex(INDEX_NONE)
-	{}
+	GENERATED_BODY()
 
-	int32 ParentIndex = INDEX_NONE;
-	int32 LastChildIndex = INDEX_NONE;
+	/** Step the solver at a fixed rate and interpolate between the last two steps */
+	UPROPERTY(EditAnywhere)
+	bool bUseFixedTimeStep = false;
 
-	int32 NumChildren = 0;
-	float BoneLengthToParent = 0.0f;
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "bUseFixedTimeStep", ClampMin = "1.0", Units = "Hz"))
+	float FixedTimeStepRate = 30.0f;
 
-	FMeshPoseBoneIndex MeshPoseBoneIndex;
-	FCompactPoseBoneIndex CompactPoseBoneIndex;
+	/** Time beyond this many steps per evaluation is dropped */
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "bUseFixedTimeStep", ClampMin = "1"))
+	int32 MaxSubsteps = 4;
+
+	/** Skip the simulation of chains that came to rest while their inputs do not change */
+	UPROPERTY(EditAnywhere)
+	bool bAllowSleep = false;
 
-	FTransform ComponentSpaceTM;
-	FTransform PoseComponentSpaceTM;
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "bAllowSleep", ClampMin = "0.0"))
+	float SleepThreshold = 0.01f;
 
-	FVector PrevLocation = FVector::ZeroVector;
-	FVector Normal = FVector::UpVector;
-	FVector Velocity = FVector::ZeroVector;
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "bAllowSleep", ClampMin = "1"))
+	int32 SleepFrames = 10;
 
-	bool bValid = false;
+	/** Collision, length and angle constraints are relaxed up to this many times per step */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "1", ClampMax = "16"))
+	int32 ConstraintIterations = 1;
+
+	/** Relaxation stops once no bone is corrected by more than this */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "0.0"))
+	float ConstraintTolerance = 0.01f;
+
+	UPROPERTY(EditAnywhere)
+	EAnimPhysSolverMode SolverMode = EAnimPhysSolverMode::Inline;
+
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "SolverMode == EAnimPhysSolverMode::Pipelined"))
+	EAnimPhysPipelineLatency PipelineLatency = EAnimPhysPipelineLatency::OneFrame;
+
+	/** Step the solver once every this many evaluations and blend the last two solver states in between. Fixed time steps are stretched by it instead */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "1", ClampMax = "8"))
+	int32 SimulationRateDivisor = 1;
+
+	/** While the pose is interpolated by the update rate optimizations, step at least as rarely as their update rate */
+	UPROPERTY(EditAnywhere)
+	bool bSimulationRateFromURO = false;
+
+	/** Extrapolate from the last two solver states in between steps, which does not lag behind but may overshoot */
+	UPROPERTY(EditAnywhere)
+	bool bExtrapolateBetweenSteps = false;
+
+	/** Skipped time is caught up with in up to this many steps, but no fewer than the simulation rate divisor, the rest is dropped */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "1", ClampMax = "8"))
+	int32 MaxCatchUpSteps = 1;
+
+	/** Skip the simulation while the mesh is not rendered, only the roots keep following the pose */
+	UPROPERTY(EditAnywhere)
+	bool bSkipWhileNotRendered = false;
+
+	/** Coming back on screen after this long settles to the pose instead of catching up */
+	UPROPERTY(EditAnywhere, meta = (EditCondition = "bSkipWhileNotRendered", ClampMin = "0.0", Units = "s"))
+	float OffscreenSettleTime = 1.0f;
+
+public:
+	float GetFixedDeltaTime() const { return 1.0f / FMath::Max(1.0f, FixedTimeStepRate); }
+};
+
+// Features dropped from a predicted LOD on, INDEX_NONE keeps them at every LOD
+USTRUCT()
+struct ANIMPHYS_API FAnimPhysLODSettings
+{
+	GENERATED_BODY()
+
+	/** Physics bodies are not collided with from this LOD on */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "-1"))
+	int32 NoPhysBodyCollisionLOD = INDEX_NONE;
+
+	/** Nothing is collided with from this LOD on */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "-1"))
+	int32 NoCollisionLOD = INDEX_NONE;
+
+	/** Bones are only pulled to the pose by the stiffness from this LOD on, without inertia, gravity or wind */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "-1"))
+	int32 StiffnessOnlyLOD = INDEX_NONE;
+
+	/** The pose is passed through from this LOD on */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "-1"))
+	int32 DisabledLOD = INDEX_NONE;
+
+	/** Only every DecimationStep-th bone down a chain is simulated from this LOD on, the bones in between follow the simulated ones */
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "-1"))
+	int32 DecimationLOD = INDEX_NONE;
+
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "2", EditCondition = "DecimationLOD >= 0"))
+	int32 DecimationStep = 4;
+
+public:
+	static bool IsReached(const int32 InThresholdLOD, const int32 InLOD) { return InThresholdLOD >= 0 && InLOD >= InThresholdLOD; }
+
+	bool IsDisabled(const int32 InLOD) const { return IsReached(DisabledLOD, InLOD); }
+	int32 GetDecimationStep(const int32 InLOD) const { return IsReached(DecimationLOD, InLOD) ? FMath::Max(2, DecimationStep) : 1; }
+	uint32 GetColliderTypes(const int32 InLOD) const;
+	uint32 GetSolverFeatures(const int32 InLOD) const;
+};
+
+// Limits kept as sine and cosine, so the solver does not need any trig
+struct ANIMPHYS_API FAnimPhys_AxisAngleLimit
+{
+	float Min = 0.0f;
+	float MinCos = 1.0f;
+	float MinSin = 0.0f;
+
+	float Max = 0.0f;
+	float MaxCos = 1.0f;
+	float MaxSin = 0.0f;
+
+	bool bEnabled = false;
+
+public:
+	void Set(const FVector2D& InLimitAngle);
+};
+
+struct ANIMPHYS_API FAnimPhys_AngleLimits
+{
+	float ConeCos = -1.0f;
+	float ConeSin = 0.0f;
+	bool bConeEnabled = false;
+
+	FAnimPhys_AxisAngleLimit AxisX;
+	FAnimPhys_AxisAngleLimit AxisY;
+	FAnimPhys_AxisAngleLimit AxisZ;
+	bool bAxisEnabled = false;
+
+	// Cleared by the quality level, every limit is disabled then
+	bool bAllowed = true;
+
+public:
+	void Set(const FAnimPhysSetupSettings& InSetupSettings, const bool bInAllowed);
+};
+
+struct ANIMPHYS_API FAnimPhys_SimulatedChain_WorkData
+{
+	int32 RootIndex = INDEX_NONE;
+
+	// Slot of the root's parent bone in the cached transforms
+	int32 ParentCachedSlot = INDEX_NONE;
+
+	// Sphere around the root that the chain can reach, for the collision broadphase
+	FVector BoundsCenter = FVector::ZeroVector;
+	float BoundsRadius = 0.0f;
+	bool bOverlapsAllColliders = true;
+
+	int32 NumFramesAtRest = 0;
+	float MaxStepDeltaSquared = 0.0f;
+
+	bool bPoseChanged = true;
+	bool bSleeping = false;
+	bool bHasCachedLocalTransforms = false;
 };
 
 struct ANIMPHYS_API FAnimPhys_Simulated_WorkData
 {
-	TArray<FAnimPhys_SimulatedBone_WorkData> SimulatedBones;
+	// Cold data, only touched when (re)building and when applying to the pose.
+	// Topology points into the shared setup, so it stays valid as long as Setup is held.
+	FAnimPhys_CompiledSetupPtr Setup;
+	TArrayView<const FAnimPhys_SimulatedBone_Topology> Topology;
+	TArray<FCompactPoseBoneIndex> CompactPoseBoneIndexes;
+	TBitArray<> ValidBones;
+
+	// Hot data, one contiguous stream per field, indexed like Topology
+	TArray<FVector> Locations;
+	TArray<FVector> PrevLocations;
+	TArray<FVector> Velocities;
+	TArray<FVector> PoseLocations;
+	TArray<float> BoneLengths;
+
+	// Only needed for angle limits and for rebuilding rotations in ApplySimulateBones
+	TArray<FQuat> PoseRotations;
+	TArray<FVector> PoseScales;
+	TArray<FQuat> Rotations;
+
+	// Output of the last apply, reused while a chain is sleeping
+	TArray<FTransform> LocalTransforms;
+
+	// Pose the chain fell asleep in, so a slow drift of the pose wakes it up as well
+	TArray<FVector> SleepPoseLocations;
+	TArray<FQuat> SleepPoseRotations;
+
+	// Bones left out by decimation, indexed like DecimatedTopology
+	TArrayView<const FAnimPhys_DecimatedBone_Topology> DecimatedTopology;
+	TArray<FCompactPoseBoneIndex> DecimatedCompactPoseBoneIndexes;
+	TBitArray<> ValidDecimatedBones;
+	TArray<FTransform> DecimatedPoseTransforms;
+	TArray<FTransform> DecimatedTransforms;
+	TArray<FTransform> DecimatedLocalTransforms;
+
+	// One per simulated root
+	TArray<FAnimPhys_SimulatedChain_WorkData> Chains;
+
+	FAnimPhys_AngleLimits AngleLimits;
+
+	// Only used with a fixed time step, the solver state before the last step
+	TArray<FVector> LastStepLocations;
+	TArray<FVector> InterpolatedLocations;
+
 	int32 CapturedPoseBonesNum = 0;
+	int32 MaxSimulatedBones = 0;
+	int32 DecimationStep = 1;
+
+	// Constraint passes used by the last step
+	int32 NumConstraintIterations = 0;
+
+	// Generation of the cached transforms the parent slots were resolved for
+	int32 CachedGeneration = INDEX_NONE;
 
 	bool bDampingEnabled = false;
 	bool bStiffnessEnabled = false;
 	bool bGravityEnabled = false;
 	bool bWindEnabled = false;
 	bool bWorldDampingEnabled = false;
+
+	// AnimPhysSolverFeatures the kernels may use
+	uint32 AllowedFeatures = MAX_uint32;
+
+public:
+	int32 Num() const { return Topology.Num(); }
+	bool IsEmpty() const { return Topology.IsEmpty(); }
+	bool IsValidIndex(int32 InIndex) const { return Topology.IsValidIndex(InIndex); }
+
+	void Init(const FAnimPhys_CompiledSetupPtr& InSetup);
+	void Empty();
+
+	FTransform GetPoseComponentSpaceTransform(int32 InIndex) const;
+	void SetPoseComponentSpaceTransform(int32 InIndex, const FTransform& InPoseComponentSpaceTM);
+	void ResetToPose(int32 InIndex);
+	void WakeAllChains();
+
+	bool IsSleeping(int32 InIndex) const { return Chains[Topology[InIndex].ChainIndex].bSleeping; }
 };
 
 struct ANIMPHYS_API FAnimPhys_Cached_WorkData
 {
-	TMap<FMeshPoseBoneIndex, FTransform> ComponentSpaceTMs;
-	TMap<FMeshPoseBoneIndex, FTransform> AttachedComponentSpaceTMs;
+	// Dense, one slot per cached bone, gathered from the component in slot order
+	TArray<FTransform> ComponentSpaceTMs;
+	TArray<FTransform> AttachedComponentSpaceTMs;
+
+	// Shared with every instance caching the same bones
+	FAnimPhys_CompiledCacheSlotsPtr SlotTable;
+	FAnimPhys_CompiledCacheSlotsPtr AttachedSlotTable;
 
 	int32 NumComponentSpaceTransforms = 0;
 	int32 NumAttachedComponentSpaceTransforms = 0;
 
+	// Bumped whenever the slots change
+	int32 Generation = 0;
+
 	FName AttachedMesh = NAME_None;
 
 	bool bHasCachedTransforms = false;
 
 	bool bInterpolated = false;
+
+public:
+	void Empty();
+	void SetBoneIndexes(const TArray<int32>& InBoneIndexes, const int32 InNumBones);
+	void SetAttachedBoneIndexes(const TArray<int32>& InBoneIndexes, const int32 InNumBones);
+
+	int32 FindSlot(const FMeshPoseBoneIndex& InMeshPoseBoneIndex) const
+	{
+		return SlotTable.IsValid() ? SlotTable->FindSlot(InMeshPoseBoneIndex) : INDEX_NONE;
+	}
+
+	int32 FindAttachedSlot(const FMeshPoseBoneIndex& InMeshPoseBoneIndex) const
+	{
+		return AttachedSlotTable.IsValid() ? AttachedSlotTable->FindSlot(InMeshPoseBoneIndex) : INDEX_NONE;
+	}
 };
 
 struct ANIMPHYS_API FAnimPhys_Forced_WorkData
@@ -229,22 +504,45 @@ struct ANIMPHYS_API FAnimPhys_Forced_WorkData
 	FVector WindVelocity = FVector::ZeroVector;
 	float GravityZ = 0.0f;
 	FVector Impulse = FVector::ZeroVector;
+
+	// Per simulated bone, regenerated every step
+	TArray<float> WindNoise;
+	uint32 WindNoiseSeed = 0;
+	uint32 WindNoiseStep = 0;
+
+public:
+	void GenerateWindNoise(int32 InNum);
 };
 
-struct ANIMPHYS_API FAnimPhys_CollidedBase_WorkData
+// What does not change after a collider is built, shared by the instances through FAnimPhys_CompiledColliders
+struct ANIMPHYS_API FAnimPhys_ColliderDefinition
 {
-	FAnimPhys_CollidedBase_WorkData()
+	FAnimPhys_ColliderDefinition()
 		: MeshPoseBoneIndex(INDEX_NONE)
 	{}
 
 	float LimitDistanceSquared = 0.0f;
 	float LimitDistance = 0.0f;
 
+	// Capsules only
+	float HalfHeight = 0.0f;
+
 	FMeshPoseBoneIndex MeshPoseBoneIndex;
 	FTransform OffsetTransform = FTransform::Identity;
 	bool bHasOffset = false;
 	bool bFromAttachedMesh = false;
 
+#if WITH_EDITORONLY_DATA
+	float DebugRadius = 0.0f;
+#endif
+};
+
+struct ANIMPHYS_API FAnimPhys_CollidedBase_WorkData
+{
+	// Owned by a compiled colliders entry the collided work data holds on to
+	const FAnimPhys_ColliderDefinition* Definition = nullptr;
+
+	int32 CachedSlot = INDEX_NONE;
 	bool bValid = false;
 
 #if WITH_EDITORONLY_DATA
@@ -255,23 +553,14 @@ struct ANIMPHYS_API FAnimPhys_CollidedBase_WorkData
 struct ANIMPHYS_API FAnimPhys_CollidedSphere_WorkData : public FAnimPhys_CollidedBase_WorkData
 {
 	FVector Center = FVector::ZeroVector;
-
-#if WITH_EDITORONLY_DATA
-	float DebugRadius = 0.0f;
-#endif
 };
 
 struct ANIMPHYS_API FAnimPhys_CollidedCapsule_WorkData : public FAnimPhys_CollidedBase_WorkData
 {
 	FVector SegmentStart = FVector::ZeroVector;
 	FVector SegmentEnd = FVector::ZeroVector;
-	float HalfHeight = 0.0f;
-
-#if WITH_EDITORONLY_DATA
-	float DebugRadius = 0.0f;
-#endif
-
 };
+
 struct ANIMPHYS_API FAnimPhys_CollidedPlanar_WorkData : public FAnimPhys_CollidedBase_WorkData
 {
 	FPlane Plane = FPlane(FVector::ZeroVector);
@@ -289,6 +578,68 @@ struct ANIMPHYS_API FAnimPhys_CollidedFloor_WorkData
 	bool bValid = false;
 };
 
+struct alignas(16) FAnimPhys_PackedSpheres
+{
+	float CenterX[4];
+	float CenterY[4];
+	float CenterZ[4];
+	float LimitDistance[4];
+	float LimitDistanceSquared[4];
+};
+
+struct alignas(16) FAnimPhys_PackedCapsules
+{
+	float StartX[4];
+	float StartY[4];
+	float StartZ[4];
+	float AxisX[4];
+	float AxisY[4];
+	float AxisZ[4];
+	float InvAxisSizeSquared[4];
+	float LimitDistance[4];
+	float LimitDistanceSquared[4];
+};
+
+struct alignas(16) FAnimPhys_PackedPlanars
+{
+	float NormalX[4];
+	float NormalY[4];
+	float NormalZ[4];
+	float W[4];
+	float LimitDistance[4];
+};
+
+// Collider definitions shared by the instances on the same key, their work data only points at them
+struct ANIMPHYS_API FAnimPhys_CompiledColliders
+{
+	TArray<FAnimPhys_ColliderDefinition> Spheres;
+	TArray<FAnimPhys_ColliderDefinition> Capsules;
+	TArray<FAnimPhys_ColliderDefinition> Planars;
+};
+
+// Valid colliders repacked every frame, 4 colliders per lane group
+struct ANIMPHYS_API FAnimPhys_PackedColliders
+{
+	TArray<FAnimPhys_PackedSpheres> Spheres;
+	TArray<FAnimPhys_PackedCapsules> Capsules;
+	TArray<FAnimPhys_PackedPlanars> Planars;
+
+	int32 NumSpheres = 0;
+	int32 NumCapsules = 0;
+	int32 NumPlanars = 0;
+
+	uint32 Hash = 0;
+	bool bChangedSinceLastStep = true;
+
+public:
+	void Reset();
+	void AddSphere(const FAnimPhys_CollidedSphere_WorkData& InSphere);
+	void AddCapsule(const FAnimPhys_CollidedCapsule_WorkData& InCapsule);
+	void AddPlanar(const FAnimPhys_CollidedPlanar_WorkData& InPlanar);
+
+	bool IsEmpty() const { return (NumSpheres + NumCapsules + NumPlanars) == 0; }
+};
+
 struct ANIMPHYS_API FAnimPhys_Collided_WorkData
 {
 	TArray<FAnimPhys_CollidedSphere_WorkData> Spheres;
@@ -299,7 +650,20 @@ struct ANIMPHYS_API FAnimPhys_Collided_WorkData
 	TArray<FAnimPhys_CollidedSphere_WorkData> PhysBodySpheres;
 	TArray<FAnimPhys_CollidedCapsule_WorkData> PhysBodyCapsules;
 
+	// Shared definitions the colliders above point at, held so they stay alive and instances on the same mesh keep finding them
+	TArray<FAnimPhys_CompiledCollidersPtr> Compiled;
+	TArray<FAnimPhys_CompiledCollidersPtr> PhysBodyCompiled;
+
+	FAnimPhys_PackedColliders Packed;
+
+	// Colliders overlapping the bounds of each chain, indexed like the simulated chains
+	TArray<FAnimPhys_PackedColliders> ChainPacked;
+
 	bool bValidColliders = false;
+	bool bSweptCollision = false;
+
+	// Generation of the cached transforms the collider slots were resolved for
+	int32 CachedGeneration = INDEX_NONE;
 	bool bValidPhysBodyColliders = false;
 };
 
@@ -313,6 +677,60 @@ struct ANIMPHYS_API FAnimPhys_Moved_WorkData
 	bool OnGround = false;
 };
 
+// Per step inputs of the per-bone solver kernel
+namespace AnimPhysSolverFeatures
+{
+	enum : uint32
+	{
+		Damping = 1 << 0,
+		Stiffness = 1 << 1,
+		Gravity = 1 << 2,
+		Wind = 1 << 3,
+		WorldDamping = 1 << 4,
+		WorldLocationMoved = 1 << 5,
+		ScaleDampingWithExternalSpeed = 1 << 6,
+
+		Num = 1 << 7,
+	};
+}
+
+// Collider types the packed colliders are built from
+namespace AnimPhysColliderTypes
+{
+	enum : uint32
+	{
+		Sphere = 1 << 0,
+		Capsule = 1 << 1,
+		Planar = 1 << 2,
+		Floor = 1 << 3,
+		PhysBody = 1 << 4,
+
+		All = (Sphere | Capsule | Planar | Floor | PhysBody),
+	};
+}
+
+struct ANIMPHYS_API FAnimPhys_SolverParams
+{
+	float DeltaTime = 0.0f;
+	float LastDeltaTime = 0.0f;
+	float TargetFramerate = 0.0f;
+
+	float DampingCoefficient = 0.0f;
+	float StiffnessCoefficient = 0.0f;
+	float WorldDampingRotationCoefficient = 0.0f;
+
+	FVector GravityFactor = FVector::ZeroVector;
+	FVector WindFactor = FVector::ZeroVector;
+	FVector WorldLocationVelocity = FVector::ZeroVector;
+	float WorldLocationSpeed = 0.0f;
+
+	float ScaleDampingLerpSpeed = 0.0f;
+	FVector ScaleDampingMultiplier = FVector::OneVector;
+
+	// AnimPhysSolverFeatures the kernel is specialized on
+	uint32 Features = 0;
+};
+
 struct ANIMPHYS_API FAnimPhys_WorkData
 {
 	FAnimPhys_Simulated_WorkData Simulated;
@@ -322,19 +740,40 @@ struct ANIMPHYS_API FAnimPhys_WorkData
 	FAnimPhys_Moved_WorkData Moved;
 
 public:
-	void BuildSimulatedBones(const FCompactPose& InPose, const TArray<FBoneReference>& InBonesToSimulate, const TArray<FBoneReference>& InBonesToExculude, const FAnimPhysSetupSettings& InSetupSettings);
-	void SimulateBones(const FCompactPose& InPose, const float& InDeltaTime, const float InLastDeltaTime, const float& InTargetFramerate, const FAnimPhysSetupSettings& InSetupSettings, const FAnimPhysExternalForceSettings& InExternalForceSettings, const FAnimPhysSmoothingSettings& InSmoothingSettings);	
-	void ApplySimulateBones(FCompactPose& OutPose);
-
-	void CopyFromOldSimulateBones(const TArray<FAnimPhys_SimulatedBone_WorkData>& OldSimulateBones);
-
-	bool TryGetPoseComponentSpaceTransform(const FMeshPoseBoneIndex& InMeshPoseBoneIndex, FTransform& OutPoseComponentSpaceTM) const;
-	void CalculatePoseComponentSpace(const FCompactPose& InPose, const FAnimPhysSetupSettings& InSetupSettings, FAnimPhys_SimulatedBone_WorkData& OutBone) const;
+	void BuildSimulatedBones(const FCompactPose& InPose, const TArray<FBoneReference>& InBonesToSimulate, const TArray<FBoneReference>& InBonesToExculude, const FAnimPhysSetupSettings& InSetupSettings, const int32 InMaxSimulatedBones, const int32 InDecimationStep, const bool bInAngleLimits);
+	void SimulateBones(const float& InDeltaTime, const float InLastDeltaTime, const float& InTargetFramerate, const FAnimPhysSetupSettings& InSetupSettings, const FAnimPhysExternalForceSettings& InExternalForceSettings, const FAnimPhysSmoothingSettings& InSmoothingSettings, const FAnimPhysSimulationSettings& InSimulationSettings);
+	bool PrepareSimulateBones(const float& InDeltaTime, const float InLastDeltaTime, const float& InTargetFramerate, const FAnimPhysSetupSettings& InSetupSettings, const FAnimPhysExternalForceSettings& InExternalForceSettings, const FAnimPhysSmoothingSettings& InSmoothingSettings, const FAnimPhysSimulationSettings& InSimulationSettings, FAnimPhys_SolverParams& OutParams);
+	void DispatchSimulateBonesKernel(const FAnimPhys_SolverParams& InParams);
+	void UpdateSleepingChains(const bool bInputsAtRest, const FAnimPhysSimulationSettings& InSimulationSettings);
+
+	// Instantiated for every combination of AnimPhysSolverFeatures
+	template <uint32 InFeatures>
+	void SimulateBonesKernel(const FAnimPhys_SolverParams& InParams);
+
+	// bInFollowPoseRoots rebuilds the chains from the current pose of their roots, for evaluations that did not step
+	void ApplySimulateBones(FCompactPose& OutPose, const float InInterpolationAlpha, const bool bInFollowPoseRoots = false);
+	void InterpolateLocations(const float InInterpolationAlpha);
+	int32 RelaxConstraints(const int32 InMaxIterations, const float InTolerance);
+
+	void CopyFromOldSimulateBones(const FAnimPhys_Simulated_WorkData& OldSimulated);
+
+	void ResolveCachedSlots();
+	bool TryGetPoseComponentSpaceTransform(const int32 InCachedSlot, FTransform& OutPoseComponentSpaceTM) const;
+	void CalculatePoseComponentSpace(const FCompactPose& InPose, const FAnimPhysSetupSettings& InSetupSettings, const int32 InBoneIndex);
+
+	// Decimated bones not reached through a simulated child, after every simulated bone is calculated
+	void CalculateDecimatedPoseComponentSpace(const FCompactPose& InPose);
+	bool CalculateDecimatedPoseComponentSpace(const FCompactPose& InPose, const int32 InDecimatedIndex);
 	
-	void AdjustBoneLocation(FVector& OutBoneLocation) const;
-	void AdjustBoneLength(const FAnimPhys_SimulatedBone_WorkData& InBone, FVector& OutBoneLocation) const;
-	void AdjustBoneDirection(const FVector& InParentBoneLocation, const FTransform& InPoseComponentSpaceTM, const FTransform& InParentPoseComponentSpaceTM, const FAnimPhysSetupSettings& InSetupSettings, FVector& OutBoneLocation) const;
-	bool TryAdjustBoneDirectionByAngleLimitAxis(const FVector& InAxis, const FVector& InPoseDir, const FVector2D& InLimitAngleAxis, FVector& OutBoneDir) const;
+	void PackColliders(const uint32 InColliderTypes);
+	void PackChainColliders(const uint32 InColliderTypes);
+	const FAnimPhys_PackedColliders& GetPackedColliders(const int32 InBoneIndex, const FVector& InBoneLocation) const;
+
+	void SweepBoneLocation(const int32 InBoneIndex, const FVector& InStartLocation, FVector& OutBoneLocation) const;
+	void AdjustBoneLocation(const int32 InBoneIndex, FVector& OutBoneLocation) const;
+	void AdjustBoneLength(const int32 InBoneIndex, FVector& OutBoneLocation) const;
+	void AdjustBoneDirection(const FVector& InParentBoneLocation, const int32 InBoneIndex, FVector& OutBoneLocation) const;
+	bool TryAdjustBoneDirectionByAngleLimitAxis(const FVector& InAxis, const FVector& InPoseDir, const FAnimPhys_AxisAngleLimit& InLimit, FVector& OutBoneDir) const;
 
-	bool IsInvalidSimulatedBones(const FCompactPose& InPose) const;
+	bool IsInvalidSimulatedBones(const FCompactPose& InPose, const int32 InMaxSimulatedBones, const int32 InDecimationStep) const;
 };
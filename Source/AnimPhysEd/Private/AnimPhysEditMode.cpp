@@ -370,7 +370,7 @@ void FAnimPhysEditMode::Render(const FSceneView* View, FViewport* Viewport, FPri
 
 				DebugTarget.Type = EAnimPhysDebugType::SphereCollider;
 				DebugTarget.Index = Index;
-				DebugTarget.BoneName = PreviewMeshComponent->GetBoneName(Sphere.MeshPoseBoneIndex.GetInt());
+				DebugTarget.BoneName = PreviewMeshComponent->GetBoneName(Sphere.Definition->MeshPoseBoneIndex.GetInt());
 
 				PDI->SetHitProxy(new HAnimPhysHitProxy(DebugTarget));
 				PDI->DrawPoint(Sphere.DebugTransform.GetLocation(), FLinearColor::Yellow, 5.0f, SDPG_Foreground);
@@ -385,7 +385,7 @@ void FAnimPhysEditMode::Render(const FSceneView* View, FViewport* Viewport, FPri
 
 				DebugTarget.Type = EAnimPhysDebugType::CapsuleCollider;
 				DebugTarget.Index = Index;
-				DebugTarget.BoneName = PreviewMeshComponent->GetBoneName(Capsule.MeshPoseBoneIndex.GetInt());
+				DebugTarget.BoneName = PreviewMeshComponent->GetBoneName(Capsule.Definition->MeshPoseBoneIndex.GetInt());
 
 				PDI->SetHitProxy(new HAnimPhysHitProxy(DebugTarget));
 				PDI->DrawPoint(Capsule.DebugTransform.GetLocation(), FLinearColor::Yellow, 5.0f, SDPG_Foreground);
@@ -400,7 +400,7 @@ void FAnimPhysEditMode::Render(const FSceneView* View, FViewport* Viewport, FPri
 
 				DebugTarget.Type = EAnimPhysDebugType::SphereCollider;
 				DebugTarget.Index = Index;
-				DebugTarget.BoneName = PreviewMeshComponent->GetBoneName(Planar.MeshPoseBoneIndex.GetInt());
+				DebugTarget.BoneName = PreviewMeshComponent->GetBoneName(Planar.Definition->MeshPoseBoneIndex.GetInt());
 
 				PDI->SetHitProxy(new HAnimPhysHitProxy(DebugTarget));
 				PDI->DrawPoint(Planar.DebugTransform.GetLocation(), FLinearColor::Yellow, 5.0f, SDPG_Foreground);
@@ -96,9 +96,10 @@ void UAnimGraphNode_AnimPhys::Draw(FPrimitiveDrawInterface* PDI, USkeletalMeshCo
 	{
 		const float Radius = ActiveNode->SetupSettings.Radius;
 		const auto& SimulatedBones = ActiveNode->GetSimulatedBones();
-		for (auto& Bone : SimulatedBones)
+		for (int32 BoneIndex = 0; BoneIndex < SimulatedBones.Num(); ++BoneIndex)
 		{
-			const FVector BoneLocation = Bone.ComponentSpaceTM.GetLocation();
+			const auto& Bone = SimulatedBones.Topology[BoneIndex];
+			const FVector BoneLocation = SimulatedBones.Locations[BoneIndex];
 			PDI->DrawPoint(BoneLocation, FLinearColor::White, 5.0f, SDPG_Foreground);
 
 			if (Radius > 0.0f)
@@ -109,7 +110,7 @@ void UAnimGraphNode_AnimPhys::Draw(FPrimitiveDrawInterface* PDI, USkeletalMeshCo
 
 			if (SimulatedBones.IsValidIndex(Bone.ParentIndex))
 			{
-				DrawDashedLine(PDI, BoneLocation, SimulatedBones[Bone.ParentIndex].ComponentSpaceTM.GetLocation(), FLinearColor::White, 1, SDPG_World);
+				DrawDashedLine(PDI, BoneLocation, SimulatedBones.Locations[Bone.ParentIndex], FLinearColor::White, 1, SDPG_World);
 			}
 		}
 	}
@@ -125,9 +126,9 @@ void UAnimGraphNode_AnimPhys::Draw(FPrimitiveDrawInterface* PDI, USkeletalMeshCo
 			}
 
 #if WITH_EDITORONLY_DATA
-			DrawSphere(PDI, Sphere.DebugTransform.GetLocation(), FRotator::ZeroRotator, FVector(Sphere.DebugRadius), 24, 6, GEngine->ConstraintLimitMaterialPrismatic->GetRenderProxy(), SDPG_World);
-			DrawWireSphere(PDI, Sphere.DebugTransform.GetLocation(), FLinearColor::Black, Sphere.DebugRadius, 24, SDPG_World);
-			DrawCoordinateSystem(PDI, Sphere.DebugTransform.GetLocation(), FRotator::ZeroRotator, Sphere.DebugRadius, SDPG_World);
+			DrawSphere(PDI, Sphere.DebugTransform.GetLocation(), FRotator::ZeroRotator, FVector(Sphere.Definition->DebugRadius), 24, 6, GEngine->ConstraintLimitMaterialPrismatic->GetRenderProxy(), SDPG_World);
+			DrawWireSphere(PDI, Sphere.DebugTransform.GetLocation(), FLinearColor::Black, Sphere.Definition->DebugRadius, 24, SDPG_World);
+			DrawCoordinateSystem(PDI, Sphere.DebugTransform.GetLocation(), FRotator::ZeroRotator, Sphere.Definition->DebugRadius, SDPG_World);
 #endif
 		}
 
@@ -142,13 +143,13 @@ void UAnimGraphNode_AnimPhys::Draw(FPrimitiveDrawInterface* PDI, USkeletalMeshCo
 			FVector YAxis = Capsule.DebugTransform.GetUnitAxis(EAxis::Y);
 			FVector ZAxis = Capsule.DebugTransform.GetUnitAxis(EAxis::Z);
 
-			DrawCylinder(PDI, Capsule.DebugTransform.GetLocation(), XAxis, YAxis, ZAxis, Capsule.DebugRadius, Capsule.HalfHeight, 25,	GEngine->ConstraintLimitMaterialPrismatic->GetRenderProxy(), SDPG_World);
-			DrawSphere(PDI, Capsule.DebugTransform.GetLocation() + ZAxis * Capsule.HalfHeight, Capsule.DebugTransform.Rotator(), FVector(Capsule.DebugRadius), 24, 6, GEngine->ConstraintLimitMaterialPrismatic->GetRenderProxy(), SDPG_World);
-			DrawSphere(PDI, Capsule.DebugTransform.GetLocation() - ZAxis * Capsule.HalfHeight, Capsule.DebugTransform.Rotator(), FVector(Capsule.DebugRadius),24, 6, GEngine->ConstraintLimitMaterialPrismatic->GetRenderProxy(), SDPG_World);
+			DrawCylinder(PDI, Capsule.DebugTransform.GetLocation(), XAxis, YAxis, ZAxis, Capsule.Definition->DebugRadius, Capsule.Definition->HalfHeight, 25,	GEngine->ConstraintLimitMaterialPrismatic->GetRenderProxy(), SDPG_World);
+			DrawSphere(PDI, Capsule.DebugTransform.GetLocation() + ZAxis * Capsule.Definition->HalfHeight, Capsule.DebugTransform.Rotator(), FVector(Capsule.Definition->DebugRadius), 24, 6, GEngine->ConstraintLimitMaterialPrismatic->GetRenderProxy(), SDPG_World);
+			DrawSphere(PDI, Capsule.DebugTransform.GetLocation() - ZAxis * Capsule.Definition->HalfHeight, Capsule.DebugTransform.Rotator(), FVector(Capsule.Definition->DebugRadius),24, 6, GEngine->ConstraintLimitMaterialPrismatic->GetRenderProxy(), SDPG_World);
 
-			DrawWireCapsule(PDI, Capsule.DebugTransform.GetLocation(), XAxis, YAxis, ZAxis, FLinearColor::Black, Capsule.DebugRadius, Capsule.HalfHeight + Capsule.DebugRadius, 25, SDPG_World);
+			DrawWireCapsule(PDI, Capsule.DebugTransform.GetLocation(), XAxis, YAxis, ZAxis, FLinearColor::Black, Capsule.Definition->DebugRadius, Capsule.Definition->HalfHeight + Capsule.Definition->DebugRadius, 25, SDPG_World);
 
-			DrawCoordinateSystem(PDI, Capsule.DebugTransform.GetLocation(), Capsule.DebugTransform.Rotator(), Capsule.DebugRadius, SDPG_World);
+			DrawCoordinateSystem(PDI, Capsule.DebugTransform.GetLocation(), Capsule.DebugTransform.Rotator(), Capsule.Definition->DebugRadius, SDPG_World);
 #endif
 		}
 